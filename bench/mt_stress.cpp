@@ -0,0 +1,131 @@
+// Multi-threaded stress benchmark: throughput of VM reads and writes for
+// 1, 2, 4, ... threads, up to the number of cores or the first argument.
+//
+//   g++ -std=c++11 -O2 -DVM_THREADS -Isrc src/*.cpp bench/mt_stress.cpp
+//       -o mt_stress -lpthread
+//   ./mt_stress [max threads] [operations per thread]
+//
+// Every thread draws addresses from a hot set that mostly stays resident
+// plus a cold tail that keeps faulting and evicting. Two layouts are run:
+// all threads in one address space (shared tables, per-thread pages), and
+// one address space per thread on the same physical memory. Each is run
+// with faults evicting for themselves and with the background reclaimer
+// keeping RECLAIM_LOW to RECLAIM_HIGH frames free; p50 and p99 are fault
+// latencies, to the power of two of the vm_stats histogram.
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifndef VM_THREADS
+#error "build the stress benchmark with -DVM_THREADS"
+#endif
+
+// 1024 frames of 256 words, 2^20 pages over 3 tables
+typedef Geometry<8, 18, 28> Bench;
+
+// pages in the hot set of one thread, and how often a cold page is hit
+#define HOT_PAGES 64
+#define COLD_PERCENT 5
+
+// free frame watermarks of the reclaimer runs
+#define RECLAIM_LOW 32
+#define RECLAIM_HIGH 128
+
+static void stress(AddressSpace<Bench>* space, int id, int threads,
+                   uint64_t operations) {
+    uint64_t seed = 0x9e3779b97f4a7c15ULL * (id + 1);
+    for (uint64_t n = 0; n < operations; ++n) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t page = (seed >> 33) % HOT_PAGES;
+        if ((seed >> 20) % 100 < COLD_PERCENT) {
+            page = HOT_PAGES + (seed >> 40) % (Bench::numPages / threads
+                                               - HOT_PAGES);
+        }
+        // interleave the pages of the threads
+        page = page * threads + id;
+        const uint64_t address = page * Bench::pageSize + (seed & 0xff);
+        if (seed & 0x100) {
+            space->write(address, (word_t) n);
+        } else {
+            word_t value;
+            space->read(address, &value);
+        }
+    }
+}
+
+// the latency under which 'fraction' of the faulting translations
+// finished, rounded up to a power of two
+static uint64_t latencyPercentile(const vm_stats& stats, double fraction) {
+    uint64_t total = 0;
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i) {
+        total += stats.faultLatency[i];
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i) {
+        seen += stats.faultLatency[i];
+        if (seen > 0 && seen >= fraction * total) return 2ULL << i;
+    }
+    return 0;
+}
+
+// runs 'threads' threads, on one space or one space each, with or without
+// the reclaimer; returns ops/s
+static double run(int threads, bool shared, bool reclaim,
+                  uint64_t operations, vm_stats* stats) {
+    PhysicalMemory<Bench> memory;
+    if (reclaim) {
+        memory.frameTable().setReclaimer(RECLAIM_LOW, RECLAIM_HIGH);
+    }
+    std::vector<AddressSpace<Bench>*> spaces;
+    for (int t = 0; t < (shared ? 1 : threads); ++t) {
+        spaces.push_back(new AddressSpace<Bench>(memory));
+        spaces[t]->initialize();
+    }
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread(stress, spaces[shared ? 0 : t], t,
+                                      shared ? threads : 1, operations));
+    }
+    for (int t = 0; t < threads; ++t) workers[t].join();
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    memory.stats().snapshot(stats);
+    for (size_t t = 0; t < spaces.size(); ++t) delete spaces[t];
+    return threads * operations / seconds;
+}
+
+int main(int argc, char** argv) {
+    int maxThreads = (int) std::thread::hardware_concurrency();
+    if (argc > 1) maxThreads = atoi(argv[1]);
+    if (maxThreads < 1) maxThreads = 1;
+    const uint64_t operations = argc > 2 ? strtoull(argv[2], nullptr, 10)
+                                         : 1000000;
+
+    printf("%-8s %-8s %-8s %12s %8s %12s %8s %8s\n", "layout", "threads",
+           "reclaim", "ops/s", "scaling", "evictions", "p50 ns", "p99 ns");
+    for (int shared = 1; shared >= 0; --shared) {
+        for (int reclaim = 0; reclaim <= 1; ++reclaim) {
+            double single = 0;
+            for (int threads = 1; threads <= maxThreads; threads *= 2) {
+                vm_stats stats;
+                const double rate = run(threads, shared, reclaim, operations,
+                                        &stats);
+                if (threads == 1) single = rate;
+                printf("%-8s %-8d %-8s %12.0f %7.2fx %12llu %8llu %8llu\n",
+                       shared ? "shared" : "private", threads,
+                       reclaim ? "yes" : "no", rate, rate / single,
+                       (unsigned long long) stats.evictions,
+                       (unsigned long long) latencyPercentile(stats, 0.5),
+                       (unsigned long long) latencyPercentile(stats, 0.99));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+// Geometry and policy sweep: replays one address trace against many
+// OFFSET_WIDTH / PHYSICAL_ADDRESS_WIDTH / replacement policy combinations
+// in one build, each on a simulator of its own, all cores at once, and
+// prints the faults, evictions and throughput of every configuration.
+//
+//   g++ -std=c++11 -O2 -DNDEBUG -Isrc src/*.cpp bench/sweep.cpp
+//       -o sweep -lpthread
+//   ./sweep [-j threads] [-o offsets] [-m widths] [-p policies]
+//           [-c out.csv] trace
+//
+// The geometries are the ones in 'geometries' below, instantiated at
+// compile time with the VIRTUAL_ADDRESS_WIDTH of MemoryConstants.h; every
+// policy is run on each. -o, -m and -p take comma-separated offset widths,
+// physical address widths and policy names (cyclic, weighted, lru, clock,
+// lfu, arc) to run only some of them. -j sets the number of threads, the
+// number of cores by default. Geometries with no room for an address
+// space are listed as skipped.
+//
+// The trace, in a format of trace_format.h, is parsed once into memory
+// and shared by the replays, which share nothing else. Replays run on a
+// work-stealing pool: each thread is dealt its share of the replays and
+// takes over those of the others once its own are done. accesses/s is
+// that of one replay on one thread, with the others running.
+//
+// Built without VM_THREADS, as every simulator is used by one thread.
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include "trace_format.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef VM_THREADS
+#error "build the sweep without -DVM_THREADS"
+#endif
+
+// one configuration of the sweep and what its replay measured
+typedef struct sweep_result {
+    int offsetWidth;
+    int physicalAddressWidth;
+    uint64_t frames;
+    int policy;
+    bool ran;                   // false if no address space fits
+    uint64_t failures;          // reads or writes that returned 0
+    uint64_t mismatches;        // checked reads that saw another value
+    double seconds;
+    vm_stats stats;
+} sweep_result;
+
+typedef void (*replayer)(const std::vector<trace_record>& trace,
+                         sweep_result* result);
+
+template <int OffsetWidth, int PhysicalAddressWidth>
+static void replay(const std::vector<trace_record>& trace,
+                   sweep_result* result) {
+    typedef Geometry<OffsetWidth, PhysicalAddressWidth, VIRTUAL_ADDRESS_WIDTH>
+        G;
+    PhysicalMemory<G> memory;
+    AddressSpace<G> space(memory);
+    result->frames = G::numFrames;
+    result->ran = space.initialize() == 1
+                  && memory.frameTable().setPolicy(result->policy) == 1;
+    if (!result->ran) {
+        return;
+    }
+    memory.stats().reset();
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const trace_record& access = trace[i];
+        if (access.op == TRACE_WRITE) {
+            result->failures += space.write(access.address,
+                                            (word_t) access.value) == 0;
+            continue;
+        }
+        word_t seen = 0;
+        if (space.read(access.address, &seen) == 0) {
+            result->failures++;
+        } else if (access.op == TRACE_READ_CHECK && seen != (word_t) access.value) {
+            result->mismatches++;
+        }
+    }
+    result->seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    memory.stats().snapshot(&result->stats);
+}
+
+typedef struct sweep_geometry {
+    int offsetWidth;
+    int physicalAddressWidth;
+    replayer run;
+} sweep_geometry;
+
+#define SWEEP_GEOMETRY(O, P) {O, P, replay<O, P>}
+
+// RAM from 2^8 to 2^14 words, in pages of 8 to 64 words
+static const sweep_geometry geometries[] = {
+    SWEEP_GEOMETRY(3, 8), SWEEP_GEOMETRY(3, 10), SWEEP_GEOMETRY(3, 12),
+    SWEEP_GEOMETRY(3, 14),
+    SWEEP_GEOMETRY(4, 8), SWEEP_GEOMETRY(4, 10), SWEEP_GEOMETRY(4, 12),
+    SWEEP_GEOMETRY(4, 14),
+    SWEEP_GEOMETRY(5, 8), SWEEP_GEOMETRY(5, 10), SWEEP_GEOMETRY(5, 12),
+    SWEEP_GEOMETRY(5, 14),
+    SWEEP_GEOMETRY(6, 8), SWEEP_GEOMETRY(6, 10), SWEEP_GEOMETRY(6, 12),
+    SWEEP_GEOMETRY(6, 14),
+};
+
+/*
+ * Runs jobs on a fixed number of threads. Every thread has a deque of
+ * its own, dealt the jobs round-robin before they start: it takes jobs
+ * from the back of its deque and, once that is empty, steals from the
+ * front of the others', so a thread that drew short jobs takes over the
+ * long ones of the others. No job is added while they run, so a thread
+ * is done once every deque is empty.
+ */
+class StealingPool {
+public:
+    explicit StealingPool(unsigned threads)
+        : queues(threads), dealt(0), stolen(0) {}
+
+    void add(const std::function<void()>& job) {
+        queues[dealt++ % queues.size()].jobs.push_back(job);
+    }
+
+    // runs every job added, then returns
+    void run() {
+        std::vector<std::thread> threads;
+        for (size_t id = 0; id < queues.size(); ++id) {
+            threads.push_back(std::thread(&StealingPool::work, this, id));
+        }
+        for (size_t id = 0; id < threads.size(); ++id) {
+            threads[id].join();
+        }
+    }
+
+    // jobs that ran on another thread than they were dealt to
+    uint64_t stolenJobs() const { return stolen.load(); }
+
+private:
+    typedef struct job_queue {
+        std::mutex lock;
+        std::deque<std::function<void()> > jobs;
+    } job_queue;
+
+    void work(size_t id) {
+        std::function<void()> job;
+        while (take(id, &job)) {
+            job();
+        }
+    }
+
+    // the next job of thread id, its own or stolen; false once none is
+    // left anywhere
+    bool take(size_t id, std::function<void()>* job) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            job_queue& queue = queues[(id + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (queue.jobs.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                *job = queue.jobs.back();
+                queue.jobs.pop_back();
+            } else {
+                *job = queue.jobs.front();
+                queue.jobs.pop_front();
+                stolen++;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<job_queue> queues;
+    uint64_t dealt;
+    std::atomic<uint64_t> stolen;
+};
+
+// parses a comma-separated list of numbers, or of policy names; returns
+// false if an item is not one
+static bool parseList(const char* list, bool policies,
+                      std::vector<int>* items) {
+    while (*list != '\0') {
+        const char* end = strchr(list, ',');
+        if (end == nullptr) end = list + strlen(list);
+        const std::string item(list, end);
+        int value;
+        if (policies) {
+            value = policyByName(item.c_str());
+        } else {
+            char* rest;
+            value = (int) strtol(item.c_str(), &rest, 10);
+            if (item.empty() || *rest != '\0') value = -1;
+        }
+        if (value < 0) return false;
+        items->push_back(value);
+        list = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+// true if the list was not given, or holds value
+static bool chosen(const std::vector<int>& list, int value) {
+    if (list.empty()) return true;
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (list[i] == value) return true;
+    }
+    return false;
+}
+
+static void writeCsv(const char* path, uint64_t accesses,
+                     const std::vector<sweep_result>& results) {
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        perror(path);
+        return;
+    }
+    fprintf(out, "offset_width,physical_address_width,frames,policy,faults,"
+            "evictions,clean_evictions,table_faults,pmreads_per_access,"
+            "accesses_per_second,failures,mismatches\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const sweep_result& r = results[i];
+        if (!r.ran) continue;
+        fprintf(out, "%d,%d,%llu,%s,%llu,%llu,%llu,%llu,%.3f,%.0f,%llu,%llu\n",
+                r.offsetWidth, r.physicalAddressWidth,
+                (unsigned long long) r.frames, policyName(r.policy),
+                (unsigned long long) r.stats.faults,
+                (unsigned long long) r.stats.evictions,
+                (unsigned long long) r.stats.cleanEvictions,
+                (unsigned long long) r.stats.tableFaults,
+                accesses == 0 ? 0.0 : (double) r.stats.pmReads / accesses,
+                r.seconds > 0 ? accesses / r.seconds : 0.0,
+                (unsigned long long) r.failures,
+                (unsigned long long) r.mismatches);
+    }
+    fclose(out);
+}
+
+static int usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [-j threads] [-o offsets] [-m widths] "
+            "[-p policies] [-c out.csv] trace\n", program);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    std::vector<int> offsets;
+    std::vector<int> widths;
+    std::vector<int> policies;
+    const char* csv = nullptr;
+    int arg = 1;
+    for (; arg < argc - 1 && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "-j") == 0 && arg < argc - 2) {
+            threads = (unsigned) atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-o") == 0 && arg < argc - 2) {
+            if (!parseList(argv[++arg], false, &offsets)) return usage(argv[0]);
+        } else if (strcmp(argv[arg], "-m") == 0 && arg < argc - 2) {
+            if (!parseList(argv[++arg], false, &widths)) return usage(argv[0]);
+        } else if (strcmp(argv[arg], "-p") == 0 && arg < argc - 2) {
+            if (!parseList(argv[++arg], true, &policies)) {
+                return usage(argv[0]);
+            }
+        } else if (strcmp(argv[arg], "-c") == 0 && arg < argc - 2) {
+            csv = argv[++arg];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (arg != argc - 1) return usage(argv[0]);
+    if (threads == 0) threads = 1;
+
+    const char* data;
+    size_t size;
+    if (!mapTrace(argv[arg], &data, &size)) {
+        return 1;
+    }
+    std::vector<trace_record> trace;
+    const uint64_t badLine = forEachAccess(
+        data, size, [&trace] (uint32_t op, uint64_t address, word_t value) {
+            const trace_record access = {address, value, op};
+            trace.push_back(access);
+        });
+    if (badLine != 0) {
+        fprintf(stderr, "%s:%llu: malformed access\n", argv[arg],
+                (unsigned long long) badLine);
+        return 1;
+    }
+
+    std::vector<sweep_result> results;
+    std::vector<replayer> runs;
+    const size_t count = sizeof(geometries) / sizeof(geometries[0]);
+    for (size_t g = 0; g < count; ++g) {
+        if (!chosen(offsets, geometries[g].offsetWidth)
+            || !chosen(widths, geometries[g].physicalAddressWidth)) {
+            continue;
+        }
+        for (int policy = 0; policy < POLICY_COUNT; ++policy) {
+            if (!chosen(policies, policy)) continue;
+            sweep_result result;
+            memset(&result, 0, sizeof(result));
+            result.offsetWidth = geometries[g].offsetWidth;
+            result.physicalAddressWidth = geometries[g].physicalAddressWidth;
+            result.policy = policy;
+            results.push_back(result);
+            runs.push_back(geometries[g].run);
+        }
+    }
+    if (results.empty()) {
+        fprintf(stderr, "%s: no configuration chosen\n", argv[0]);
+        return 2;
+    }
+
+    StealingPool pool(threads);
+    for (size_t i = 0; i < results.size(); ++i) {
+        sweep_result* result = &results[i];
+        const replayer run = runs[i];
+        pool.add([&trace, result, run] () { run(trace, result); });
+    }
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    pool.run();
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    printf("%-6s %-8s %7s %-8s %10s %10s %11s %12s\n", "offset", "physical",
+           "frames", "policy", "faults", "evictions", "PMreads/acc",
+           "accesses/s");
+    int status = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const sweep_result& r = results[i];
+        if (!r.ran) {
+            printf("%-6d %-8d %7llu %-8s %10s\n", r.offsetWidth,
+                   r.physicalAddressWidth, (unsigned long long) r.frames,
+                   policyName(r.policy), "skipped");
+            continue;
+        }
+        printf("%-6d %-8d %7llu %-8s %10llu %10llu %11.2f %12.0f\n",
+               r.offsetWidth, r.physicalAddressWidth,
+               (unsigned long long) r.frames, policyName(r.policy),
+               (unsigned long long) r.stats.faults,
+               (unsigned long long) r.stats.evictions,
+               trace.empty() ? 0.0 : (double) r.stats.pmReads / trace.size(),
+               r.seconds > 0 ? trace.size() / r.seconds : 0.0);
+        if (r.failures != 0 || r.mismatches != 0) {
+            printf("  %llu failed, %llu mismatches\n",
+                   (unsigned long long) r.failures,
+                   (unsigned long long) r.mismatches);
+            status = 1;
+        }
+    }
+    printf("%zu configurations, %llu accesses each, on %u threads in "
+           "%.2f s, %llu replays stolen\n", results.size(),
+           (unsigned long long) trace.size(), threads, seconds,
+           (unsigned long long) pool.stolenJobs());
+    if (csv != nullptr) writeCsv(csv, trace.size(), results);
+    return status;
+}
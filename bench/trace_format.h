@@ -0,0 +1,178 @@
+// The address trace format read by trace_replay and sweep.
+//
+// A text trace has one access per line, numbers in decimal or 0x hex:
+//   r <address>            read
+//   r <address> <value>    read, and count a mismatch unless it is value
+//   w <address> <value>    write
+// Empty lines and lines starting with # are skipped.
+//
+// A binary trace starts with the 8 bytes "VMTRACE2" followed by packed
+// trace_record entries in host byte order. Traces starting with
+// "VMTRACE1" hold the older trace_record_v1 entries, whose values are
+// 32 bits wide, and are still read.
+#pragma once
+
+#include "MemoryConstants.h"
+#include "ReplacementPolicy.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_MAGIC "VMTRACE2"
+#define TRACE_MAGIC_V1 "VMTRACE1"
+#define TRACE_MAGIC_SIZE 8
+
+// operations of a binary trace record
+#define TRACE_READ 0
+#define TRACE_WRITE 1
+#define TRACE_READ_CHECK 2
+
+// values are as wide as the words of a -DVM_WORD64 build
+typedef struct trace_record {
+    uint64_t address;
+    int64_t value;
+    uint32_t op;                // TRACE_READ, TRACE_WRITE or TRACE_READ_CHECK
+} trace_record;
+
+typedef struct trace_record_v1 {
+    uint64_t address;
+    int32_t value;
+    uint32_t op;
+} trace_record_v1;
+
+// maps the trace at path for reading, "" if it is empty; prints why and
+// returns false if it cannot
+static inline bool mapTrace(const char* path, const char** data, size_t* size) {
+    const int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(path);
+        return false;
+    }
+    *size = status.st_size;
+    *data = "";
+    if (*size > 0) {
+        void* mapped = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return false;
+        }
+        madvise(mapped, *size, MADV_SEQUENTIAL);
+        *data = static_cast<const char*>(mapped);
+    }
+    close(fd);
+    return true;
+}
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+// parses a decimal or 0x hex number at p, which must lie before end;
+// returns nullptr if there is none
+static inline const char* parseNumber(const char* p, const char* end,
+                                      uint64_t* number) {
+    uint64_t n = 0;
+    const char* start = p;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        start = p += 2;
+        for (; p < end; ++p) {
+            const char c = *p;
+            int digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else break;
+            n = n * 16 + digit;
+        }
+    } else {
+        const bool negative = p < end && *p == '-';
+        if (negative) start = ++p;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) n = n * 10 + (*p - '0');
+        if (negative) n = (uint64_t) -(int64_t) n;
+    }
+    if (p == start) return nullptr;
+    *number = n;
+    return p;
+}
+
+// calls visit(op, address, value) for every access of a text or binary
+// trace, in order; returns the number of the first malformed text line,
+// 0 if there is none. The trace is parsed in place.
+template <class Visit>
+static uint64_t forEachAccess(const char* data, size_t size, Visit visit) {
+    if (size >= TRACE_MAGIC_SIZE
+        && memcmp(data, TRACE_MAGIC, TRACE_MAGIC_SIZE) == 0) {
+        const uint64_t count = (size - TRACE_MAGIC_SIZE)
+                               / sizeof(trace_record);
+        const trace_record* records =
+            reinterpret_cast<const trace_record*>(data + TRACE_MAGIC_SIZE);
+        for (uint64_t i = 0; i < count; ++i) {
+            visit(records[i].op, records[i].address,
+                  (word_t) records[i].value);
+        }
+        return 0;
+    }
+    if (size >= TRACE_MAGIC_SIZE
+        && memcmp(data, TRACE_MAGIC_V1, TRACE_MAGIC_SIZE) == 0) {
+        const uint64_t count = (size - TRACE_MAGIC_SIZE)
+                               / sizeof(trace_record_v1);
+        const trace_record_v1* records =
+            reinterpret_cast<const trace_record_v1*>(data
+                                                     + TRACE_MAGIC_SIZE);
+        for (uint64_t i = 0; i < count; ++i) {
+            visit(records[i].op, records[i].address,
+                  (word_t) records[i].value);
+        }
+        return 0;
+    }
+    const char* p = data;
+    const char* const end = data + size;
+    for (uint64_t line = 1; p < end; ++line) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == nullptr) eol = end;
+        p = skipBlanks(p, eol);
+        if (p < eol && *p != '#') {
+            const char op = *p++;
+            uint64_t address = 0;
+            uint64_t value = 0;
+            if ((op != 'r' && op != 'w')
+                || (p = parseNumber(skipBlanks(p, eol), eol, &address))
+                   == nullptr) {
+                return line;
+            }
+            p = skipBlanks(p, eol);
+            const bool hasValue = p < eol;
+            if ((hasValue && (p = parseNumber(p, eol, &value)) == nullptr)
+                || (op == 'w' && !hasValue)
+                || skipBlanks(p, eol) != eol) {
+                return line;
+            }
+            visit(op == 'w' ? TRACE_WRITE
+                            : hasValue ? TRACE_READ_CHECK : TRACE_READ,
+                  address, (word_t) value);
+        }
+        p = eol + 1;
+    }
+    return 0;
+}
+
+// the name of a POLICY_* kind on the command line
+static inline const char* policyName(int policy) {
+    static const char* const names[POLICY_COUNT] =
+        {"cyclic", "weighted", "lru", "clock", "lfu", "arc"};
+    return names[policy];
+}
+
+static inline int policyByName(const char* name) {
+    for (int i = 0; i < POLICY_COUNT; ++i) {
+        if (strcmp(name, policyName(i)) == 0) return i;
+    }
+    return -1;
+}
@@ -0,0 +1,170 @@
+// Trace replay: streams an address trace through VMread and VMwrite and
+// reports the throughput and what the accesses cost the physical memory.
+//
+//   g++ -std=c++11 -O2 -DNDEBUG -Isrc src/*.cpp bench/trace_replay.cpp
+//       -o trace_replay
+//   ./trace_replay [-H] [-p policy] [-s backend swapfile]
+//                  [-i image] [-o image] trace
+//
+// The geometry is the one of MemoryConstants.h; to replay against another
+// one, build with a MemoryConstants.h of that geometry first on the
+// include path (as tests/MemoryConstants_test2.h is used). policy is one
+// of cyclic, weighted, lru, clock, lfu and arc; backend one of memory,
+// pread, mmap, uring and compressed (the in-memory backends ignore the
+// swapfile argument). -H maps dense regions with huge pages, see
+// VMsetHugePages. -i starts from a memory image saved by VMsave, for
+// example by an earlier run with -o, which saves one after the replay;
+// the policy and huge page mode are then the image's.
+//
+// The trace formats are described in trace_format.h.
+//
+// The trace is mapped, not read, and parsed in place; nothing is printed
+// until the end.
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include "trace_format.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+// outcome of a replay
+typedef struct replay_result {
+    uint64_t accesses;
+    uint64_t failures;          // VMread or VMwrite returned 0
+    uint64_t mismatches;        // checked reads that saw another value
+} replay_result;
+
+static void replayOne(uint32_t op, uint64_t address, word_t value,
+                      replay_result* result) {
+    result->accesses++;
+    if (op == TRACE_WRITE) {
+        result->failures += VMwrite(address, value) == 0;
+        return;
+    }
+    word_t seen = 0;
+    if (VMread(address, &seen) == 0) {
+        result->failures++;
+    } else if (op == TRACE_READ_CHECK && seen != value) {
+        result->mismatches++;
+    }
+}
+
+static int backendByName(const char* name) {
+    static const char* const names[] = {"memory", "pread", "mmap", "uring",
+                                        "compressed"};
+    for (int i = 0; i < 5; ++i) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [-H] [-p policy] [-s backend swapfile] "
+            "[-i image] [-o image] trace\n", program);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    int policy = POLICY_CYCLIC;
+    int backend = SWAP_MEMORY;
+    const char* swapPath = nullptr;
+    bool huge = false;
+    const char* imageIn = nullptr;
+    const char* imageOut = nullptr;
+    int arg = 1;
+    for (; arg < argc - 1 && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "-p") == 0) {
+            policy = policyByName(argv[++arg]);
+            if (policy < 0) return usage(argv[0]);
+        } else if (strcmp(argv[arg], "-s") == 0 && arg < argc - 2) {
+            backend = backendByName(argv[++arg]);
+            swapPath = argv[++arg];
+            if (backend < 0) return usage(argv[0]);
+        } else if (strcmp(argv[arg], "-H") == 0) {
+            huge = true;
+        } else if (strcmp(argv[arg], "-i") == 0 && arg < argc - 2) {
+            imageIn = argv[++arg];
+        } else if (strcmp(argv[arg], "-o") == 0 && arg < argc - 2) {
+            imageOut = argv[++arg];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (arg != argc - 1) return usage(argv[0]);
+
+    const char* data;
+    size_t size;
+    if (!mapTrace(argv[arg], &data, &size)) {
+        return 1;
+    }
+
+    if (swapPath != nullptr) {
+        if (VMinitialize(backend, swapPath) == 0) {
+            perror(swapPath);
+            return 1;
+        }
+    } else {
+        VMinitialize();
+    }
+    VMsetReplacementPolicy(policy);
+    if (huge && VMsetHugePages(1) == 0) {
+        fprintf(stderr, "huge pages are not available\n");
+        return 1;
+    }
+    if (imageIn != nullptr && VMload(imageIn) == 0) {
+        fprintf(stderr, "%s: not an image of this geometry\n", imageIn);
+        return 1;
+    }
+
+    VMresetStats();
+    replay_result result = {0, 0, 0};
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    const uint64_t badLine = forEachAccess(
+        data, size, [&result] (uint32_t op, uint64_t address, word_t value) {
+            replayOne(op, address, value, &result);
+        });
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (badLine != 0) {
+        fprintf(stderr, "%s:%llu: malformed access\n", argv[arg],
+                (unsigned long long) badLine);
+        return 1;
+    }
+
+    printf("accesses      %12llu\n", (unsigned long long) result.accesses);
+    printf("accesses/s    %12.0f\n",
+           seconds > 0 ? result.accesses / seconds : 0.0);
+    printf("failed        %12llu\n", (unsigned long long) result.failures);
+    printf("mismatches    %12llu\n", (unsigned long long) result.mismatches);
+    vm_stats stats;
+    VMgetStats(&stats);
+    printf("page faults   %12llu\n", (unsigned long long) stats.faults);
+    printf("table faults  %12llu\n", (unsigned long long) stats.tableFaults);
+    printf("huge faults   %12llu\n", (unsigned long long) stats.hugeFaults);
+    printf("evictions     %12llu\n", (unsigned long long) stats.evictions);
+    printf("clean         %12llu\n",
+           (unsigned long long) stats.cleanEvictions);
+    printf("restores      %12llu\n", (unsigned long long) stats.swapFaults);
+    printf("table reuses  %12llu\n",
+           (unsigned long long) stats.emptyTableReuses);
+    printf("PMread        %12llu\n", (unsigned long long) stats.pmReads);
+    printf("PMwrite       %12llu\n", (unsigned long long) stats.pmWrites);
+    printf("ns/evict      %12.0f\n", stats.evictions > 0
+           ? (double) stats.evictNanoseconds / stats.evictions : 0.0);
+    printf("ns/restore    %12.0f\n", stats.faults > 0
+           ? (double) stats.restoreNanoseconds / stats.faults : 0.0);
+    printf("swapped pages %12llu\n", (unsigned long long) stats.swappedPages);
+    printf("swap ratio    %12.2f\n", stats.swapFootprint > 0
+           ? (double) stats.swappedPages * PAGE_SIZE * sizeof(word_t)
+             / stats.swapFootprint : 0.0);
+    if (imageOut != nullptr && VMsave(imageOut) == 0) {
+        perror(imageOut);
+        return 1;
+    }
+    return result.failures != 0 || result.mismatches != 0;
+}
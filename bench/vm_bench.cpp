@@ -0,0 +1,277 @@
+// Access pattern benchmark: runs standard workloads over the whole virtual
+// memory through VMwrite, then VMread, and reports per operation cost.
+//
+//   g++ -std=c++11 -O2 -DNDEBUG -Isrc src/*.cpp bench/vm_bench.cpp
+//       -o vm_bench
+//   ./vm_bench [-n operations] [-p policy] [-j out.json] [-c out.csv]
+//
+// Workloads, over VIRTUAL_MEMORY_SIZE words:
+//   sequential     every word in order
+//   strided        one page and one word apart
+//   uniform        uniformly random words
+//   zipfian        pages drawn with Zipf exponent ZIPF_EXPONENT
+//   workingset     a window of WORKING_SET_PAGES pages that moves on
+//                  every WORKING_SET_PHASE operations
+//   pointerchase   one word per page on a random cycle; the writes lay the
+//                  cycle out, every read goes to the address it read
+// For each workload and operation the table lists ns/op, page faults per
+// op and PMread calls per access (table walks included). Addresses are
+// generated before the timed loop. Every workload starts on an empty
+// memory and swap. policy is one of cyclic, weighted, lru, clock, lfu and
+// arc, as for trace_replay.
+// A -DVM_CHECK_INDEX build also walks every table on each fault to check
+// the frames it picked, and counts the PMread calls of that walk; its
+// figures are not comparable with those of a release build.
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include "trace_format.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#define ZIPF_EXPONENT 0.99
+#define WORKING_SET_PAGES (NUM_FRAMES / 2)
+#define WORKING_SET_PHASE 4096
+
+// one timed pass of a workload
+typedef struct bench_result {
+    const char* workload;
+    const char* op;             // "write" or "read"
+    uint64_t operations;
+    double nsPerOp;
+    double faultsPerOp;
+    double pmReadsPerOp;
+} bench_result;
+
+typedef void (*generator)(std::vector<uint64_t>& addresses);
+
+static uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+static uint64_t nextRandom() {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 11;
+}
+
+static void sequential(std::vector<uint64_t>& addresses) {
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        addresses[i] = i % VIRTUAL_MEMORY_SIZE;
+    }
+}
+
+static void strided(std::vector<uint64_t>& addresses) {
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        addresses[i] = (i * (PAGE_SIZE + 1)) % VIRTUAL_MEMORY_SIZE;
+    }
+}
+
+static void uniform(std::vector<uint64_t>& addresses) {
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        addresses[i] = nextRandom() % VIRTUAL_MEMORY_SIZE;
+    }
+}
+
+static void zipfian(std::vector<uint64_t>& addresses) {
+    // cumulative weights of the pages, the most popular ones scattered
+    std::vector<double> cdf(NUM_PAGES);
+    double sum = 0;
+    for (uint64_t p = 0; p < NUM_PAGES; ++p) {
+        sum += 1.0 / pow((double) (p + 1), ZIPF_EXPONENT);
+        cdf[p] = sum;
+    }
+    std::vector<uint64_t> rank(NUM_PAGES);
+    for (uint64_t p = 0; p < NUM_PAGES; ++p) rank[p] = p;
+    for (uint64_t p = NUM_PAGES - 1; p > 0; --p) {
+        std::swap(rank[p], rank[nextRandom() % (p + 1)]);
+    }
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        const double u = (nextRandom() / (double) (1ULL << 53)) * sum;
+        const uint64_t p = std::lower_bound(cdf.begin(), cdf.end(), u)
+                           - cdf.begin();
+        addresses[i] = rank[std::min<uint64_t>(p, NUM_PAGES - 1)] * PAGE_SIZE
+                       + nextRandom() % PAGE_SIZE;
+    }
+}
+
+static void workingSet(std::vector<uint64_t>& addresses) {
+    uint64_t base = 0;
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        if (i % WORKING_SET_PHASE == 0) {
+            base = nextRandom() % NUM_PAGES;
+        }
+        const uint64_t page = (base + nextRandom() % WORKING_SET_PAGES)
+                              % NUM_PAGES;
+        addresses[i] = page * PAGE_SIZE + nextRandom() % PAGE_SIZE;
+    }
+}
+
+// the cycle in visiting order: Sattolo's shuffle gives a single cycle
+static void pointerChase(std::vector<uint64_t>& addresses) {
+    std::vector<uint64_t> pages(NUM_PAGES);
+    for (uint64_t p = 0; p < NUM_PAGES; ++p) pages[p] = p;
+    for (uint64_t p = NUM_PAGES - 1; p > 0; --p) {
+        std::swap(pages[p], pages[nextRandom() % p]);
+    }
+    for (uint64_t i = 0; i < addresses.size(); ++i) {
+        const uint64_t page = pages[i % NUM_PAGES];
+        addresses[i] = page * PAGE_SIZE + page % PAGE_SIZE;
+    }
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static bench_result measure(const char* workload, const char* op,
+                            uint64_t operations, double ns, uint64_t faults,
+                            uint64_t reads) {
+    bench_result result;
+    result.workload = workload;
+    result.op = op;
+    result.operations = operations;
+    result.nsPerOp = ns / operations;
+    result.faultsPerOp = (double) faults / operations;
+    result.pmReadsPerOp = (double) reads / operations;
+    return result;
+}
+
+// writes the addresses, then reads them back; the pointer chase writes
+// the address of the next word and reads follow the values
+static void run(const char* workload, generator generate, bool chase,
+                uint64_t operations, int policy,
+                std::vector<bench_result>& results) {
+    std::vector<uint64_t> addresses(operations);
+    generate(addresses);
+    VMinitialize(SWAP_MEMORY, nullptr);
+    VMsetReplacementPolicy(policy);
+
+    vm_stats stats;
+    VMresetStats();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < operations; ++i) {
+        const word_t value = chase ? (word_t) addresses[(i + 1) % operations]
+                                   : (word_t) i;
+        VMwrite(addresses[i], value);
+    }
+    double ns = elapsedNs(start);
+    VMgetStats(&stats);
+    results.push_back(measure(workload, "write", operations, ns,
+                              stats.faults, stats.pmReads));
+
+    VMresetStats();
+    word_t sink = 0;
+    start = std::chrono::steady_clock::now();
+    if (chase) {
+        uint64_t address = addresses[0];
+        for (uint64_t i = 0; i < operations; ++i) {
+            word_t next;
+            VMread(address, &next);
+            address = (uint64_t) next;
+        }
+        sink = (word_t) address;
+    } else {
+        for (uint64_t i = 0; i < operations; ++i) {
+            word_t value;
+            VMread(addresses[i], &value);
+            sink += value;
+        }
+    }
+    ns = elapsedNs(start);
+    VMgetStats(&stats);
+    results.push_back(measure(workload, "read", operations, ns,
+                              stats.faults, stats.pmReads));
+    // keep the reads from being optimized away
+    if (sink == 1) fputc('\0', stderr);
+}
+
+static void writeJson(const char* path, const std::vector<bench_result>& results) {
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        perror(path);
+        return;
+    }
+    fprintf(out, "{\"geometry\": {\"offsetWidth\": %d, "
+            "\"physicalAddressWidth\": %d, \"virtualAddressWidth\": %d},\n"
+            " \"results\": [\n", OFFSET_WIDTH, PHYSICAL_ADDRESS_WIDTH,
+            VIRTUAL_ADDRESS_WIDTH);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result& r = results[i];
+        fprintf(out, "  {\"workload\": \"%s\", \"op\": \"%s\", "
+                "\"operations\": %llu, \"ns_per_op\": %.2f, "
+                "\"faults_per_op\": %.4f, \"pmreads_per_op\": %.3f}%s\n",
+                r.workload, r.op, (unsigned long long) r.operations,
+                r.nsPerOp, r.faultsPerOp, r.pmReadsPerOp,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, " ]}\n");
+    fclose(out);
+}
+
+static void writeCsv(const char* path, const std::vector<bench_result>& results) {
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        perror(path);
+        return;
+    }
+    fprintf(out, "workload,op,operations,ns_per_op,faults_per_op,"
+            "pmreads_per_op\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result& r = results[i];
+        fprintf(out, "%s,%s,%llu,%.2f,%.4f,%.3f\n", r.workload, r.op,
+                (unsigned long long) r.operations, r.nsPerOp, r.faultsPerOp,
+                r.pmReadsPerOp);
+    }
+    fclose(out);
+}
+
+int main(int argc, char** argv) {
+    uint64_t operations = 1000000;
+    int policy = POLICY_CYCLIC;
+    const char* json = nullptr;
+    const char* csv = nullptr;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+            operations = strtoull(argv[++arg], nullptr, 10);
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-p") == 0) {
+            policy = policyByName(argv[++arg]);
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+            json = argv[++arg];
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0) {
+            csv = argv[++arg];
+        } else {
+            fprintf(stderr, "usage: %s [-n operations] [-p policy] "
+                    "[-j out.json] [-c out.csv]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (operations == 0 || policy < 0 || policy >= POLICY_COUNT) {
+        fprintf(stderr, "%s: bad operation count or policy\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<bench_result> results;
+    run("sequential", sequential, false, operations, policy, results);
+    run("strided", strided, false, operations, policy, results);
+    run("uniform", uniform, false, operations, policy, results);
+    run("zipfian", zipfian, false, operations, policy, results);
+    run("workingset", workingSet, false, operations, policy, results);
+    run("pointerchase", pointerChase, true, operations, policy, results);
+
+    printf("%-13s %-6s %10s %10s %12s\n", "workload", "op", "ns/op",
+           "faults/op", "PMreads/op");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result& r = results[i];
+        printf("%-13s %-6s %10.1f %10.4f %12.3f\n", r.workload, r.op,
+               r.nsPerOp, r.faultsPerOp, r.pmReadsPerOp);
+    }
+    if (json != nullptr) writeJson(json, results);
+    if (csv != nullptr) writeCsv(csv, results);
+    return 0;
+}
@@ -0,0 +1,1168 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#include "Geometry.h"
+#include "PhysicalMemory.h"
+#include "FrameTable.h"
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#ifdef VM_THREADS
+#include <atomic>
+#include <thread>
+#endif
+
+#ifndef SUCCESS
+#define SUCCESS 1
+#endif
+#ifndef FAILURE
+#define FAILURE 0
+#endif
+
+// translation cache geometry, can be overridden at compile time
+#ifndef TLB_SETS
+#define TLB_SETS 64
+#endif
+#ifndef TLB_WAYS
+#define TLB_WAYS 4
+#endif
+
+// pages a readahead stream starts with, see setReadahead
+#define READAHEAD_MIN_WINDOW 2
+
+/**
+ * One way of the translation cache.
+ * Frame 0 only ever holds a root table, so frame 0 marks an empty way.
+ */
+typedef struct tlb_entry{
+  uint64_t page;             // Virtual page number
+  word_t frame;              // Frame holding the page
+  uint64_t lastUse;          // Stamp for LRU replacement inside the set
+}tlb_entry;
+
+/**
+ * Paged virtual memory of geometry G, one of any number of address spaces
+ * on top of a PhysicalMemory<G>. Every space has its own root table and
+ * translation cache and competes with the others for the frames, see
+ * FrameTable. Every size, shift and mask comes from G at compile time and
+ * the table walk is unrolled per level. The VM* functions work on the
+ * instance of DefaultGeometry.
+ *
+ * A space must be destroyed before its PhysicalMemory.
+ *
+ * fork makes another space a copy of this one that shares every frame
+ * and swapped page with it: either side gets a frame of its own for a
+ * page only when it first writes it.
+ *
+ * Built with VM_THREADS, read, write and the range operations may be
+ * called from any number of threads at once, on one space or several
+ * sharing a memory; see FrameTable for the locking. Concurrent accesses
+ * to the same word race as they would on real memory. initialize and
+ * destruction still need every thread of the memory to be idle.
+ */
+template <class G>
+class AddressSpace
+{
+  // the tables translate every page number bit once, up to 63-bit
+  // virtual addresses, and none is wider than a page
+  static_assert (G::layerShift (0) + G::layerWidth (0) == G::pageWidth
+                 && G::layerWidth (0) <= G::offsetWidth,
+                 "the table layers split the page number");
+
+public:
+  explicit AddressSpace (PhysicalMemory<G> &physicalMemory)
+      : memory (physicalMemory), frameTable (physicalMemory.frameTable ()),
+        space (-1), root (0), readaheadMax (0), prefetchRound (0)
+  {
+#ifdef VM_THREADS
+    for (int s = 0; s < TLB_SETS; ++s)
+    {
+      tlbLocks[s].clear ();
+      tlbFills[s] = 0;
+    }
+#endif
+    tlbFlush ();
+    readaheadReset ();
+  }
+
+  // Give the frames and swapped pages of the space back to the memory
+  ~AddressSpace ()
+  {
+    if (space >= 0)
+    {
+      frameTable.detach (space);
+    }
+  }
+
+  AddressSpace (const AddressSpace &) = delete;
+  AddressSpace &operator= (const AddressSpace &) = delete;
+
+  /** Initialize the virtual memory by clearing root page table.
+   * Must be called before any read or write operations. The first call
+   * attaches the space to its physical memory; later calls give the
+   * frames of the space back, other spaces keep theirs.
+   * @return 1 on success and 0 if the physical memory could not
+   * allocate its RAM or cannot take another address space
+   */
+  int initialize ()
+  {
+    if (memory.allocated () == 0)
+    {
+      return FAILURE;
+    }
+    if (space < 0)
+    {
+      space = frameTable.attach (this);
+      if (space < 0)
+      {
+        return FAILURE;
+      }
+      root = frameTable.rootOf (space);
+    }
+    else
+    {
+      frameTable.clear (space);
+    }
+    tlbFlush ();
+    readaheadReset ();
+    return SUCCESS;
+  }
+
+  /** Make child a copy of this space, as a process fork would. Both go
+   * on sharing every frame and swapped page of this space: reads of a
+   * page neither wrote since are served from its frame, and the first
+   * write of either side copies the page into a frame of its own, with
+   * the tables on its path created empty. Forking costs two cleared root
+   * tables however many pages are resident. child must be on the same
+   * physical memory; if it was initialized, its pages are dropped first.
+   * Later initialize calls of either side end its sharing.
+   * @return 1 on success, 0 with VM_THREADS, if this space is not
+   * initialized, if child is this space or on another memory, or if the
+   * physical memory cannot take two more root tables and room for a
+   * copy-on-write fault, see FrameTable::fork
+   */
+  int fork (AddressSpace &child)
+  {
+    if (space < 0 || &child == this || &child.frameTable != &frameTable)
+    {
+      return FAILURE;
+    }
+    const int id = frameTable.fork (space, &child, child.space);
+    if (id < 0)
+    {
+      return FAILURE;
+    }
+    child.space = id;
+    child.root = frameTable.rootOf (id);
+    child.tlbFlush ();
+    child.readaheadReset ();
+    return SUCCESS;
+  }
+
+  /** Fault pages in ahead of a stream of faults. Two faults 'stride'
+   * pages apart after a fault the same stride back start a stream; the
+   * next pages of the stream are then faulted in, their tables included,
+   * as soon as the faulting access is done, and more follow as the
+   * prefetched pages are used. The window starts at READAHEAD_MIN_WINDOW
+   * pages, doubles once a window's worth of prefetched pages was used
+   * and halves for every prefetched page evicted unused, between that and
+   * maxPages (at most half the frames). 0 turns readahead off.
+   * @return 1 on success, 0 with VM_THREADS, where the fault stream of a
+   * space is not one thread's
+   */
+  int setReadahead (uint64_t maxPages)
+  {
+#ifdef VM_THREADS
+    (void) maxPages;
+    return FAILURE;
+#else
+    readaheadMax = std::min<uint64_t> (maxPages, G::numFrames / 2);
+    if (readaheadMax != 0 && !prefetched)
+    {
+      prefetched.reset (new FrameArray<uint32_t> (G::numFrames));
+    }
+    readaheadReset ();
+    return SUCCESS;
+#endif
+  }
+
+  /** Initialize the virtual memory with evicted pages kept by the given
+   * swap backend, dropping everything swapped out so far. The swap device
+   * belongs to the physical memory, so this also drops the pages other
+   * address spaces swapped out: choose the backend before sharing.
+   * @return 1 on success and 0 if the swap file could not be set up or
+   * initialize () fails
+   */
+  int initialize (int swapBackend, const char *swapPath)
+  {
+    if (memory.initializeSwap (swapBackend, swapPath) == 0)
+    {
+      return FAILURE;
+    }
+    return initialize ();
+  }
+
+  /** reads a word from the given virtual address
+   * and puts its content in value.
+   * @return 1 on success and 0 on failure (if the address cannot be mapped
+   * to a physical address for any reason, the swap device failing
+   * included)
+   */
+  int read (uint64_t virtualAddress, word_t *value)
+  {
+    if (checkValidity (virtualAddress, value) == 0){
+      return FAILURE;
+    }
+    const uint64_t physicalAddress = findPhysicalAddress (virtualAddress,
+                                                          false);
+    if (physicalAddress == failedAddress){
+      return FAILURE;
+    }
+    memory.read (physicalAddress, value);
+    release (physicalAddress);
+    return SUCCESS;
+  }
+
+  /** writes a word to the given virtual address
+   * @return 1 on success and 0 on failure (if the address cannot be mapped
+   * to a physical address for any reason, the swap device failing
+   * included)
+   */
+  int write (uint64_t virtualAddress, word_t value)
+  {
+    if (checkValidity (virtualAddress, &value) == 0){
+      return FAILURE;
+    }
+    const uint64_t physicalAddress = findPhysicalAddress (virtualAddress,
+                                                          true);
+    if (physicalAddress == failedAddress){
+      return FAILURE;
+    }
+    memory.write (physicalAddress, value);
+    release (physicalAddress);
+    return SUCCESS;
+  }
+
+  /** reads 'count' words from virtualAddress on into buffer,
+   * translating each page of the range once
+   * @return 1 on success and 0 if the range cannot be mapped; the words
+   * of the pages before one the swap device failed on are read all the
+   * same
+   */
+  int readRange (uint64_t virtualAddress, word_t *buffer, uint64_t count)
+  {
+    if (buffer == nullptr || checkRange (virtualAddress, count) == 0){
+      return FAILURE;
+    }
+    while (count > 0)
+    {
+      const uint64_t chunk = chunkInPage (virtualAddress, count);
+      const uint64_t physicalAddress = findPhysicalAddress (virtualAddress,
+                                                            false);
+      if (physicalAddress == failedAddress){
+        return FAILURE;
+      }
+      memcpy (buffer, memory.data (physicalAddress), chunk * sizeof (word_t));
+      release (physicalAddress);
+      virtualAddress += chunk;
+      buffer += chunk;
+      count -= chunk;
+    }
+    return SUCCESS;
+  }
+
+  /** writes 'count' words from buffer to virtualAddress on,
+   * translating each page of the range once
+   * @return 1 on success and 0 if the range cannot be mapped; the pages
+   * before one the swap device failed on are written all the same
+   */
+  int writeRange (uint64_t virtualAddress, const word_t *buffer,
+                  uint64_t count)
+  {
+    if (buffer == nullptr || checkRange (virtualAddress, count) == 0){
+      return FAILURE;
+    }
+    while (count > 0)
+    {
+      const uint64_t chunk = chunkInPage (virtualAddress, count);
+      const uint64_t physicalAddress = findPhysicalAddress (virtualAddress,
+                                                            true);
+      if (physicalAddress == failedAddress){
+        return FAILURE;
+      }
+      memcpy (memory.data (physicalAddress), buffer, chunk * sizeof (word_t));
+      memory.markDirty (physicalAddress >> G::offsetWidth);
+      release (physicalAddress);
+      virtualAddress += chunk;
+      buffer += chunk;
+      count -= chunk;
+    }
+    return SUCCESS;
+  }
+
+  /** writes value to 'count' words from virtualAddress on
+   * @return 1 on success and 0 if the range cannot be mapped, like
+   * writeRange
+   */
+  int fill (uint64_t virtualAddress, word_t value, uint64_t count)
+  {
+    if (checkRange (virtualAddress, count) == 0){
+      return FAILURE;
+    }
+    while (count > 0)
+    {
+      const uint64_t chunk = chunkInPage (virtualAddress, count);
+      const uint64_t physicalAddress = findPhysicalAddress (virtualAddress,
+                                                            true);
+      if (physicalAddress == failedAddress){
+        return FAILURE;
+      }
+      word_t *words = memory.data (physicalAddress);
+      for (uint64_t i = 0; i < chunk; ++i)
+      {
+        words[i] = value;
+      }
+      memory.markDirty (physicalAddress >> G::offsetWidth);
+      release (physicalAddress);
+      virtualAddress += chunk;
+      count -= chunk;
+    }
+    return SUCCESS;
+  }
+
+  /** copies 'count' words from source to destination, the ranges may
+   * overlap. Each step copies the largest run that stays within one
+   * source page and one destination page, frame to frame.
+   * @return 1 on success and 0 if either range cannot be mapped, like
+   * writeRange
+   */
+  int copy (uint64_t destination, uint64_t source, uint64_t count)
+  {
+    if (checkRange (destination, count) == 0
+        || checkRange (source, count) == 0){
+      return FAILURE;
+    }
+    const uint64_t mask = G::pageSize - 1;
+    // copy from the end when the destination overlaps the source's tail
+    const bool backwards = destination > source
+                           && destination - source < count;
+    while (count > 0)
+    {
+      uint64_t chunk = count;
+      if (!backwards)
+      {
+        chunk = std::min (chunk, G::pageSize - (source & mask));
+        chunk = std::min (chunk, G::pageSize - (destination & mask));
+        if (copyChunk (destination, source, chunk) == FAILURE){
+          return FAILURE;
+        }
+        destination += chunk;
+        source += chunk;
+      }
+      else
+      {
+        chunk = std::min (chunk, ((source + count - 1) & mask) + 1);
+        chunk = std::min (chunk, ((destination + count - 1) & mask) + 1);
+        if (copyChunk (destination + count - chunk, source + count - chunk,
+                       chunk) == FAILURE){
+          return FAILURE;
+        }
+      }
+      count -= chunk;
+    }
+    return SUCCESS;
+  }
+
+  // number of translations served from the translation cache
+  uint64_t tlbHitCount () const
+  {
+    return tlbHits;
+  }
+
+  // number of translations that had to walk the page tables
+  uint64_t tlbMissCount () const
+  {
+    return tlbMisses;
+  }
+
+private:
+  friend class FrameTable<G>;
+
+  // Keep other threads out of one set of the translation cache
+  void tlbLock (const uint64_t page)
+  {
+#ifdef VM_THREADS
+    while (tlbLocks[page % TLB_SETS].test_and_set (std::memory_order_acquire))
+    {
+      std::this_thread::yield ();
+    }
+#else
+    (void) page;
+#endif
+  }
+
+  void tlbUnlock (const uint64_t page)
+  {
+#ifdef VM_THREADS
+    tlbLocks[page % TLB_SETS].clear (std::memory_order_release);
+#else
+    (void) page;
+#endif
+  }
+
+  // Look up the frame of a page in the translation cache, 0 on a miss
+  word_t tlbLookup (const uint64_t page)
+  {
+    tlbLock (page);
+    tlb_entry *set = tlb[page % TLB_SETS];
+    for (int i = 0; i < TLB_WAYS; ++i)
+    {
+      if (set[i].frame != 0 && set[i].page == page)
+      {
+        set[i].lastUse = ++tlbClock;
+        tlbHits++;
+        const word_t frame = set[i].frame;
+        tlbUnlock (page);
+        return frame;
+      }
+    }
+    tlbMisses++;
+    tlbUnlock (page);
+    return 0;
+  }
+
+  // Cache a translation, replacing the one of the same page or else the
+  // least recently used way of its set
+  void tlbInsert (const uint64_t page, const word_t frame)
+  {
+    tlbLock (page);
+#ifdef VM_THREADS
+    tlbFills[page % TLB_SETS]++;
+#endif
+    tlbPlace (page, frame);
+    tlbUnlock (page);
+  }
+
+#ifdef VM_THREADS
+  // number of translations cached in the set of page so far
+  uint64_t tlbFillCount (const uint64_t page) const
+  {
+    return tlbFills[page % TLB_SETS];
+  }
+
+  // Cache the zero frame for a page a walk found never written, unless
+  // the set cached a translation since 'fills' was read before the walk:
+  // a write of another thread may have mapped the page meanwhile. Were
+  // it mapped after this, its translation replaces this one.
+  void tlbInsertZero (const uint64_t page, const uint64_t fills)
+  {
+    tlbLock (page);
+    if (tlbFills[page % TLB_SETS] == fills)
+    {
+      tlbPlace (page, zeroFrame);
+    }
+    tlbUnlock (page);
+  }
+#endif
+
+  // Fill a way of the set of page, which the caller holds
+  void tlbPlace (const uint64_t page, const word_t frame)
+  {
+    tlb_entry *set = tlb[page % TLB_SETS];
+    tlb_entry *victim = nullptr;
+    for (int i = 0; i < TLB_WAYS && victim == nullptr; ++i)
+    {
+      if (set[i].frame != 0 && set[i].page == page)
+      {
+        victim = &set[i];
+      }
+    }
+    for (int i = 0; i < TLB_WAYS && victim == nullptr; ++i)
+    {
+      if (set[i].frame == 0)
+      {
+        victim = &set[i];
+      }
+    }
+    if (victim == nullptr)
+    {
+      victim = &set[0];
+      for (int i = 1; i < TLB_WAYS; ++i)
+      {
+        if (set[i].lastUse < victim->lastUse)
+        {
+          victim = &set[i];
+        }
+      }
+    }
+    victim->page = page;
+    victim->frame = frame;
+    victim->lastUse = ++tlbClock;
+  }
+
+  // Drop the cached translation of a page that is leaving RAM
+  void tlbInvalidate (const uint64_t page)
+  {
+    tlbLock (page);
+    tlb_entry *set = tlb[page % TLB_SETS];
+    for (int i = 0; i < TLB_WAYS; ++i)
+    {
+      if (set[i].frame != 0 && set[i].page == page)
+      {
+        set[i].frame = 0;
+      }
+    }
+    tlbUnlock (page);
+  }
+
+  // Drop every cached translation and reset the counters
+  void tlbFlush ()
+  {
+    for (int s = 0; s < TLB_SETS; ++s)
+    {
+      for (int i = 0; i < TLB_WAYS; ++i)
+      {
+        tlb[s][i].frame = 0;
+        tlb[s][i].lastUse = 0;
+      }
+    }
+    tlbClock = 0;
+    tlbHits = 0;
+    tlbMisses = 0;
+  }
+
+  /**
+   * One level of the table walk for 'page' of space 'owner', this space
+   * or an origin of it, unrolled at compile time:
+   * reads the entry of 'table' at Layer, faults in the next table (or the
+   * page itself at the last layer) when it is missing, and continues with
+   * the next layer.
+   * 'table' is locked, exclusively if 'exclusive', and is unlocked once
+   * the next frame is locked. The frame of the page is returned locked
+   * shared, or 0 if the walk has to start over because another thread
+   * changed the tables meanwhile. What the walk costs is added to trace.
+   * Unless the walk is for a write, a page that is neither mapped nor
+   * swapped was never written: the zero frame is returned for it, not
+   * locked, and nothing is faulted in. If owner has an origin, the page
+   * is looked up there instead; a write copies the origin's page into a
+   * frame of owner's.
+   * One layer above the last, an entry may map a huge page, which ends
+   * the walk; with huge pages on, a missing entry there is filled with
+   * one unless no run of frames can be had (see FrameTable::findHugeRun).
+   * If the swap device fails to evict or restore a page, the walk gives
+   * up: 0 is returned with trace->failed set.
+   */
+  template <int Layer>
+  word_t walk (uint64_t page, int owner, word_t table, bool exclusive,
+               bool write, int *occupied, walk_trace *trace,
+               std::integral_constant<int, Layer>)
+  {
+    typedef typename G::template Level<Layer> level;
+    const uint64_t offset = (page >> level::shift) & level::mask;
+    const uint64_t entry = table * G::pageSize + offset;
+    word_t next;
+    memory.read (entry, &next);
+    trace->tables++;
+    trace->reads++;
+    if (Layer == G::tablesDepth - 2
+        && (next & FrameTable<G>::hugeEntry ()) != 0)
+    {
+      const word_t frame = (next & ~FrameTable<G>::hugeEntry ())
+                           + (word_t) G::tableIndex (G::tablesDepth - 1, page);
+      frameTable.lockShared (frame);
+      if (exclusive)
+      {
+        frameTable.unlockExclusive (table);
+      }
+      else
+      {
+        frameTable.unlockShared (table);
+      }
+      return frame;
+    }
+    const int origin = frameTable.originOf (owner);
+    if (next == 0 && !write
+        && !memory.swapped (FrameTable<G>::swapKey (owner, page)))
+    {
+      if (exclusive)
+      {
+        frameTable.unlockExclusive (table);
+      }
+      else
+      {
+        frameTable.unlockShared (table);
+      }
+      // the first table on the path is the one a copy-on-write fault
+      // holds, when this walks an origin for it
+      return origin < 0 ? zeroFrame
+                        : walkOrigin (page, origin, occupied[0], trace);
+    }
+    if (next == 0 && !exclusive)
+    {
+      const uint64_t prefix = Layer == 0 ? 0 : (page >> level::prefixShift)
+                                               << level::prefixShift;
+      if (!frameTable.upgrade (table, owner, Layer, prefix))
+      {
+        return 0;
+      }
+      exclusive = true;
+#ifdef VM_THREADS
+      // another thread may have filled the entry while it was unlocked
+      memory.read (entry, &next);
+      trace->reads++;
+#endif
+    }
+    if (next == 0){
+      const std::chrono::steady_clock::time_point start
+          = std::chrono::steady_clock::now ();
+      const word_t huge = Layer == G::tablesDepth - 2 && origin < 0
+                          && frameTable.hugePages ()
+                          ? frameTable.findHugeRun (occupied, table) : 0;
+      if (huge != 0)
+      {
+        const word_t frame = mapHuge (page, owner, huge, table, entry,
+                                      offset);
+        frameTable.unlockExclusive (table);
+        if (frame == 0)
+        {
+          trace->failed = true;
+          return 0;
+        }
+        trace->fills++;
+        const std::chrono::nanoseconds spent
+            = std::chrono::steady_clock::now () - start;
+        trace->nanoseconds += spent.count ();
+        return frame;
+      }
+      // the frame of the origin's copy of a page owner never wrote
+      word_t source = 0;
+      int sourceSpace = origin;
+      if (Layer == G::tablesDepth - 1 && origin >= 0
+          && !memory.swapped (FrameTable<G>::swapKey (owner, page)))
+      {
+        source = walkOrigin (page, origin, table, trace);
+        if (source == 0)
+        {
+          frameTable.unlockExclusive (table);
+          return 0;
+        }
+        if (source != zeroFrame)
+        {
+          sourceSpace = frameTable.spaceOf (source);
+        }
+      }
+      next = frameTable.findEmptyFrame (occupied, owner, page, table);
+      if (source != 0 && source != zeroFrame)
+      {
+        frameTable.unlockShared (source);
+      }
+      if (next == FrameTable<G>::swapFailed ())
+      {
+        trace->failed = true;
+        next = 0;
+      }
+      if (next == 0)
+      {
+        frameTable.unlockExclusive (table);
+        return 0;
+      }
+      int filled = 1;
+      if (Layer < G::tablesDepth - 1)
+      {
+        // Initialize new page table
+        memory.clearFrame (next);
+      }
+      else if (source != 0)
+      {
+        // Copy the origin's page, from swap if it was evicted meanwhile
+        const bool resident = source == zeroFrame
+                              || frameTable.holdsPage (source, sourceSpace,
+                                                       page);
+        filled = memory.copyPage (next, resident ? source : 0,
+                                  FrameTable<G>::swapKey (sourceSpace, page));
+      }
+      else {
+        // Restore page from disk
+        filled = memory.restore (next, FrameTable<G>::swapKey (owner, page));
+      }
+      if (!filled)
+      {
+        frameTable.releaseFrames (next, 1);
+        frameTable.unlockExclusive (table);
+        trace->failed = true;
+        return 0;
+      }
+      if (Layer < G::tablesDepth - 1)
+      {
+        memory.stats ().recordTableFault ();
+      }
+      memory.write (entry, next);
+      frameTable.linkFrame (next, table, offset, Layer + 1,
+                 (page >> level::shift) << level::shift);
+      frameTable.unlockExclusive (table);
+      trace->fills++;
+      const std::chrono::nanoseconds spent
+          = std::chrono::steady_clock::now () - start;
+      trace->nanoseconds += spent.count ();
+      // a new table is filled right away, so it stays exclusive
+      if (Layer == G::tablesDepth - 1)
+      {
+        frameTable.downgrade (next);
+        exclusive = false;
+      }
+    }
+    else
+    {
+      if (FrameTable<G>::notOccupied (occupied, next))
+      {
+        // Tables already on the path must not be reclaimed as empty
+        FrameTable<G>::makeOccupied (occupied, next);
+      }
+      frameTable.lockShared (next);
+      if (exclusive)
+      {
+        frameTable.unlockExclusive (table);
+      }
+      else
+      {
+        frameTable.unlockShared (table);
+      }
+      exclusive = false;
+    }
+    return walk (page, owner, next, exclusive, write, occupied, trace,
+                 std::integral_constant<int, Layer + 1> ());
+  }
+
+  // Walk an origin for the page a space sees there, see FrameTable::fork,
+  // as walk returns it. 'kept' is a table the space holds that must not
+  // be reclaimed meanwhile, 0 if none.
+  word_t walkOrigin (uint64_t page, int origin, word_t kept,
+                     walk_trace *trace)
+  {
+    int occupied[G::tablesDepth] = {0};
+    if (kept != 0)
+    {
+      FrameTable<G>::makeOccupied (occupied, kept);
+    }
+    const word_t table = frameTable.rootOf (origin);
+    frameTable.lockShared (table);
+    return walk (page, origin, table, false, false, occupied, trace,
+                 std::integral_constant<int, 0> ());
+  }
+
+  // Fault in the pages under the entry of table at offset into the run of
+  // frames from base on, link them as one huge page and return the frame
+  // of 'page', locked shared. If the swap device cannot restore them all,
+  // the run is given back and 0 returned.
+  word_t mapHuge (uint64_t page, int owner, word_t base, word_t table,
+                  uint64_t entry, uint64_t offset)
+  {
+    const uint64_t run = FrameTable<G>::hugeRun ();
+    const uint64_t first = page & ~(run - 1);
+    for (uint64_t i = 0; i < run; ++i)
+    {
+      if (!memory.restore (base + i,
+                           FrameTable<G>::swapKey (owner, first + i)))
+      {
+        frameTable.releaseFrames (base, run);
+        return 0;
+      }
+    }
+    memory.write (entry, base | FrameTable<G>::hugeEntry ());
+    frameTable.linkHuge (base, table, offset, first);
+    memory.stats ().recordHugeFault ();
+    const word_t frame = base + (word_t) (page - first);
+    frameTable.lockShared (frame);
+    return frame;
+  }
+
+  // Past the last layer the walk has reached the page's frame
+  word_t walk (uint64_t, int, word_t frame, bool, bool, int *, walk_trace *,
+               std::integral_constant<int, G::tablesDepth>)
+  {
+    return frame;
+  }
+
+  // translate virtual address to physical address, find the correct frame and manage page faults.
+  // The frame stays locked until release. Reads of never-written pages
+  // get an address in the zero frame; a write gives the page a frame of
+  // its own, a copy of the zero frame, or of the origin's frame for a
+  // page read from there. failedAddress is returned, with nothing
+  // locked, if the swap device failed.
+  uint64_t findPhysicalAddress (uint64_t virtualAddress, bool write)
+  {
+    const uint64_t page = virtualAddress >> G::offsetWidth;
+    const uint64_t offset = virtualAddress & (G::pageSize - 1);
+    word_t frame = tlbLookup (page);
+#ifndef VM_THREADS
+    // a page still read from the origin is copied on the first write;
+    // forks are not available with VM_THREADS, where the frame metadata
+    // is only read once the frame is locked
+    if (write && frame != 0
+        && (frame == zeroFrame || frameTable.spaceOf (frame) != space))
+#else
+    if (write && frame == zeroFrame)
+#endif
+    {
+      tlbInvalidate (page);
+      frame = 0;
+    }
+#ifdef VM_THREADS
+    if (frame != 0 && frame != zeroFrame)
+    {
+      // the page may have been evicted since it was cached
+      frameTable.lockShared (frame);
+      if (!frameTable.holdsPage (frame, space, page))
+      {
+        frameTable.unlockShared (frame);
+        frame = 0;
+      }
+    }
+#endif
+    walk_trace trace = {0, 0, 0, 0, false};
+    while (frame == 0)
+    {
+      int occupied[G::tablesDepth] = {0};
+#ifdef VM_THREADS
+      const uint64_t fills = tlbFillCount (page);
+#endif
+      frameTable.lockShared (root);
+      frame = walk (page, space, root, false, write, occupied, &trace,
+                    std::integral_constant<int, 0> ());
+      if (trace.failed)
+      {
+        return failedAddress;
+      }
+      if (frame != 0)
+      {
+#ifdef VM_THREADS
+        // a write of another thread may map the page meanwhile
+        if (frame == zeroFrame)
+        {
+          tlbInsertZero (page, fills);
+        }
+        else
+#endif
+        {
+          tlbInsert (page, frame);
+        }
+        memory.stats ().recordWalk (trace);
+      }
+#ifdef VM_THREADS
+      else
+      {
+        std::this_thread::yield ();
+      }
+#endif
+    }
+    if (frame == zeroFrame)
+    {
+      memory.stats ().recordZeroRead ();
+      return frame * G::pageSize + offset;
+    }
+    frameTable.touch (frame);
+    if (readaheadMax != 0)
+    {
+      readaheadNote (page, frame, trace.fills != 0);
+    }
+    return frame * G::pageSize + offset;
+  }
+
+  // Let go of the frame a physical address from findPhysicalAddress is in,
+  // then read ahead if the access asked for it
+  void release (uint64_t physicalAddress)
+  {
+    if ((physicalAddress >> G::offsetWidth) == zeroFrame)
+    {
+      return;
+    }
+    frameTable.unlockShared (physicalAddress >> G::offsetWidth);
+    if (readaheadPending)
+    {
+      readahead ();
+    }
+  }
+
+  // Forget the stream and the prefetched pages, which are all gone or
+  // about to be. Marks of earlier rounds read as unmarked, so only a
+  // wrapped round clears the marks.
+  void readaheadReset ()
+  {
+    if (++prefetchRound == 0)
+    {
+      if (prefetched)
+      {
+        prefetched->clear ();
+      }
+      prefetchRound = 1;
+    }
+    readaheadWindow = std::min<uint64_t> (READAHEAD_MIN_WINDOW, readaheadMax);
+    readaheadCredit = 0;
+    streamLast = 0;
+    streamStride = 0;
+    streamHead = 0;
+    streamLive = false;
+    readaheadPending = false;
+  }
+
+  // Follow the fault stream: a demand fault may start or continue it, the
+  // first use of a prefetched page moves it on
+  void readaheadNote (uint64_t page, word_t frame, bool faulted)
+  {
+    const int64_t current = (int64_t) page;
+    if (faulted)
+    {
+      const int64_t step = current - streamLast;
+      streamLive = step != 0 && step == streamStride;
+      streamStride = step;
+      streamLast = current;
+      // the page was not prefetched, so neither are the ones past it
+      streamHead = current;
+      readaheadPending = streamLive;
+      return;
+    }
+    if ((*prefetched)[frame] != prefetchRound)
+    {
+      return;
+    }
+    (*prefetched)[frame] = 0;
+    memory.stats ().recordPrefetchUsed ();
+    if (++readaheadCredit >= readaheadWindow)
+    {
+      readaheadWindow = std::min (readaheadWindow * 2, readaheadMax);
+      readaheadCredit = 0;
+    }
+    if (streamLive)
+    {
+      streamLast = current;
+      readaheadPending = true;
+    }
+  }
+
+  // Fault in the pages of the stream up to a window past its last page
+  void readahead ()
+  {
+    readaheadPending = false;
+    int64_t ahead = (streamHead - streamLast) / streamStride;
+    if (ahead < 0 || (streamHead - streamLast) % streamStride != 0)
+    {
+      ahead = 0;
+    }
+    for (int64_t k = ahead + 1; k <= (int64_t) readaheadWindow; ++k)
+    {
+      const int64_t next = streamLast + k * streamStride;
+      if (next < 0 || next >= (int64_t) G::numPages)
+      {
+        break;
+      }
+      prefetch ((uint64_t) next);
+      streamHead = next;
+    }
+  }
+
+  // Fault a page in without accessing it, unless it is resident or was
+  // never written
+  void prefetch (uint64_t page)
+  {
+    walk_trace trace = {0, 0, 0, 0, false};
+    word_t frame = 0;
+    while (frame == 0)
+    {
+      int occupied[G::tablesDepth] = {0};
+      frameTable.lockShared (root);
+      frame = walk (page, space, root, false, false, occupied, &trace,
+                    std::integral_constant<int, 0> ());
+      if (trace.failed)
+      {
+        // the demand fault on the page will report it
+        return;
+      }
+    }
+    if (frame == zeroFrame)
+    {
+      return;
+    }
+    frameTable.unlockShared (frame);
+    if (trace.fills != 0)
+    {
+      memory.stats ().recordWalk (trace);
+      memory.stats ().recordPrefetch ();
+      (*prefetched)[frame] = prefetchRound;
+    }
+  }
+
+  // A page of the space was evicted from frame
+  void pageEvicted (uint64_t page, word_t frame)
+  {
+    tlbInvalidate (page);
+    if (prefetched && (*prefetched)[frame] == prefetchRound)
+    {
+      (*prefetched)[frame] = 0;
+      memory.stats ().recordPrefetchWasted ();
+      readaheadWindow = std::max<uint64_t> (readaheadWindow / 2,
+                                            std::min<uint64_t> (
+                                                READAHEAD_MIN_WINDOW,
+                                                readaheadMax));
+      readaheadCredit = 0;
+    }
+  }
+
+  // The space goes on under a new id after a fork, its old one is the
+  // origin now. Cached translations still read the same pages, writes
+  // check whose frame they hit.
+  void forked (int id)
+  {
+    space = id;
+    root = frameTable.rootOf (id);
+  }
+
+  // The frames of the memory were loaded from an image: the root may have
+  // moved and every cached translation is stale
+  void framesReloaded ()
+  {
+    root = frameTable.rootOf (space);
+    tlbFlush ();
+    readaheadReset ();
+  }
+
+  // number of words from virtualAddress to the end of its page, at most count
+  static uint64_t chunkInPage (uint64_t virtualAddress, uint64_t count)
+  {
+    const uint64_t left = G::pageSize - (virtualAddress & (G::pageSize - 1));
+    return left < count ? left : count;
+  }
+
+  /**
+   * Copy a run that lies within one source and one destination page.
+   * The source page is pinned while the destination is faulted in; only
+   * when RAM cannot hold both pages at once is the run bounced through
+   * a buffer instead. Pins are not shared between threads, so with
+   * VM_THREADS every run is bounced.
+   * @return 1 on success and 0 if the swap device failed
+   */
+  int copyChunk (uint64_t destination, uint64_t source, uint64_t count)
+  {
+#ifndef VM_THREADS
+    const uint64_t sourcePage = source >> G::offsetWidth;
+    const uint64_t from = findPhysicalAddress (source, false);
+    if (from == failedAddress)
+    {
+      return FAILURE;
+    }
+    const bool zero = (from >> G::offsetWidth) == zeroFrame;
+    // the source page may be an origin's
+    const int sourceSpace = zero ? space
+                                 : frameTable.spaceOf (from >> G::offsetWidth);
+    if (!zero)
+    {
+      frameTable.pin (from >> G::offsetWidth);
+    }
+    uint64_t to = findPhysicalAddress (destination, true);
+    if (!zero)
+    {
+      frameTable.unpin ();
+    }
+    if (to == failedAddress)
+    {
+      release (from);
+      return FAILURE;
+    }
+    if (zero
+        || frameTable.holdsPage (from >> G::offsetWidth, sourceSpace,
+                                 sourcePage))
+    {
+      memmove (memory.data (to), memory.data (from), count * sizeof (word_t));
+      memory.markDirty (to >> G::offsetWidth);
+      release (to);
+      release (from);
+      return SUCCESS;
+    }
+    bounce.resize (G::pageSize);
+    if (readRange (source, bounce.data (), count) == FAILURE)
+    {
+      return FAILURE;
+    }
+    return writeRange (destination, bounce.data (), count);
+#else
+    std::vector<word_t> buffer (count);
+    if (readRange (source, buffer.data (), count) == FAILURE)
+    {
+      return FAILURE;
+    }
+    return writeRange (destination, buffer.data (), count);
+#endif
+  }
+
+  // check that the space is attached and the range starts and ends
+  // inside the virtual memory
+  int checkRange (uint64_t virtualAddress, uint64_t count) const
+  {
+    if (space < 0 || virtualAddress >= G::virtualMemorySize
+        || count > G::virtualMemorySize - virtualAddress){
+      return FAILURE;
+    }
+    return SUCCESS;
+  }
+
+  // check that the space is attached, and validity of virtual address
+  // and pointer
+  int checkValidity (uint64_t virtualAddress, const word_t *value) const
+  {
+    if (space < 0 || virtualAddress >= G::virtualMemorySize
+        || value == nullptr){
+      return FAILURE;
+    }
+    return SUCCESS;
+  }
+
+  // see PhysicalMemory
+  static constexpr word_t zeroFrame = G::numFrames;
+  // what findPhysicalAddress returns when the swap device failed
+  static constexpr uint64_t failedAddress = ~0ULL;
+
+  PhysicalMemory<G> &memory;
+  FrameTable<G> &frameTable;
+  // id of the space in frameTable, -1 until initialize
+  int space;
+  word_t root;
+
+  tlb_entry tlb[TLB_SETS][TLB_WAYS];
+#ifdef VM_THREADS
+  std::atomic_flag tlbLocks[TLB_SETS];
+  // translations cached per set, see tlbInsertZero
+  std::atomic<uint64_t> tlbFills[TLB_SETS];
+  std::atomic<uint64_t> tlbClock;
+  std::atomic<uint64_t> tlbHits;
+  std::atomic<uint64_t> tlbMisses;
+#else
+  uint64_t tlbClock;
+  uint64_t tlbHits;
+  uint64_t tlbMisses;
+#endif
+
+  // staging for copies that cannot pin their source
+  std::vector<word_t> bounce;
+
+  // readahead: the largest and the current window in pages, 0 if off
+  uint64_t readaheadMax;
+  uint64_t readaheadWindow;
+  // prefetched pages used since the window last changed
+  uint64_t readaheadCredit;
+  // the fault stream: its last page, its stride and the last page
+  // prefetched for it
+  int64_t streamLast;
+  int64_t streamStride;
+  int64_t streamHead;
+  bool streamLive;
+  // set by an access that moved the stream, served by release
+  bool readaheadPending;
+  // prefetchRound for frames holding a prefetched page of the space not
+  // used yet; made by the first setReadahead that turns readahead on
+  std::unique_ptr<FrameArray<uint32_t> > prefetched;
+  // bumped by every readaheadReset, never 0
+  uint32_t prefetchRound;
+};
+
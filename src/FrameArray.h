@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * A fixed number of zeroed entries, one per frame, for the bookkeeping of
+ * a physical memory. Like the RAM (see allocateRam) the array is only
+ * reserved: the system commits its pages as entries are first written,
+ * so a memory with many frames pays for the entries of the frames it
+ * uses. Entries are never constructed or destroyed, so T must be valid
+ * as all zero bytes. Throws std::bad_alloc if the array cannot be
+ * reserved, as the vector it stands in for would.
+ */
+template <class T>
+class FrameArray
+{
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "entries are never destroyed");
+
+public:
+    explicit FrameArray(uint64_t count)
+        : count(count), bytes(mappedBytes(count)) {
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                            -1, 0);
+        if (mapped == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        items = static_cast<T*>(mapped);
+    }
+    ~FrameArray() { munmap(items, bytes); }
+    FrameArray(const FrameArray&) = delete;
+    FrameArray& operator=(const FrameArray&) = delete;
+
+    T& operator[](uint64_t i) { return items[i]; }
+    const T& operator[](uint64_t i) const { return items[i]; }
+
+    T* data() { return items; }
+    const T* data() const { return items; }
+
+    uint64_t size() const { return count; }
+
+    /*
+     * zeroes every entry and gives the committed pages back
+     */
+    void clear() { madvise(items, bytes, MADV_DONTNEED); }
+
+private:
+    // the mapping is rounded up to whole system pages
+    static uint64_t mappedBytes(uint64_t count) {
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        return (count * sizeof(T) + page - 1) / page * page;
+    }
+
+    const uint64_t count;
+    const uint64_t bytes;
+    T* items;
+};
@@ -0,0 +1,1637 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#include "Geometry.h"
+#include "FrameArray.h"
+#include "ReplacementPolicy.h"
+#include <map>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <algorithm>
+#include <functional>
+#ifdef VM_THREADS
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#endif
+
+#ifdef VM_THREADS
+// frame lock word: number of readers, -1 while held exclusively, with this
+// bit set while a writer waits so no new reader gets in
+#define FRAME_LOCK_WAITING (1 << 30)
+// accesses for the policy are queued in this many buffers of
+// TOUCH_BUFFER frames, one per thread modulo TOUCH_STRIPES, see
+// FrameTable::touch
+#define TOUCH_STRIPES 16
+#define TOUCH_BUFFER 256
+#endif
+
+/**
+ * What one walk of the page tables of a space finds, see
+ * FrameTable::scanTables
+ * Used to check the indexes findEmptyFrame answers from
+ */
+typedef struct dfs_attributes{
+  word_t maxFrame;           // Highest frame number seen
+  uint64_t maxDistance;      // Max cyclic distance found
+  word_t parentTable;        // Parent of eviction candidate
+  word_t offset;             // Offset in parent table
+  word_t cyclicFrame;        // Frame to evict
+  word_t emptyTable;         // First empty table off the path
+  uint64_t cyclicPage;       // Page number to evict
+}dfs_attributes;
+
+template <class G> class PhysicalMemory;
+template <class G> class AddressSpace;
+
+/**
+ * The frames of one PhysicalMemory<G> and the address spaces that compete
+ * for them. Every attached space owns a root table; every other frame is
+ * handed out by findEmptyFrame on a fault in any space, so a fault in one
+ * space may reclaim an empty table or evict a page of another.
+ *
+ * Frame 0 is only ever a root table, so 0 still reads as an empty entry
+ * in every table. Pages of space s are swapped under the index
+ * s * NUM_PAGES + page, which is the page number itself for space 0.
+ * Which page is evicted is up to the replacement policy, the largest
+ * cyclic distance unless setPolicy chose another.
+ *
+ * With VM_THREADS every frame has a reader/writer lock word. Translations
+ * hold the tables on their path shared, hand over hand, and keep the
+ * frame of the page shared while its words are accessed. A fault takes
+ * the table that misses the entry exclusively, and findEmptyFrame only
+ * try-locks the table it reclaims or the page it evicts together with
+ * its parent, skipping busy ones, so threads block on each other only
+ * top-down. The indexes are guarded by one mutex that is never held
+ * across swap I/O. Accesses do not take it: a policy that tracks them
+ * is told of them in batches before it chooses a victim. Without
+ * VM_THREADS the lock functions are empty.
+ * attach, detach and clear need the memory to be quiescent; they hold
+ * off the reclaimer thread of setReclaimer themselves.
+ *
+ * With setHugePages, an entry of a table one layer above the last maps
+ * hugeRun () aligned frames at once instead of a last-level table: the
+ * entry is the first frame with hugeEntry () set. The first frame of the
+ * run is the page the policy sees, the others are FRAME_HUGE and point
+ * back to it; the run is evicted and freed as a whole.
+ *
+ * fork leaves the frames, tables and swapped pages of a space under its
+ * id, which becomes the origin of two new spaces: the forking one goes on
+ * under a new id and the child is attached, both with an empty root. A
+ * missing entry of a space with an origin reads as the origin's page
+ * unless the space swapped the page out itself, so nothing is copied
+ * until one side writes a page. An origin is never written, only faulted
+ * in and evicted, and is detached with the last space that shares it.
+ */
+template <class G>
+class FrameTable
+{
+public:
+  explicit FrameTable (PhysicalMemory<G> &physicalMemory)
+      : memory (physicalMemory), frames (G::numFrames),
+        policy (ReplacementPolicy<G>::create (POLICY_CYCLIC, frames)),
+        policyKind (POLICY_CYCLIC), trackAccess (false), freshFrame (1),
+        rootCount (0), originCount (0), pinnedFrame (0), pinnedCount (0),
+        hugeMode (false), hugeUsed (false), framesReturned (false)
+#ifdef VM_THREADS
+        , locks (G::numFrames), lowWatermark (0), highWatermark (0),
+        lastFaultSpace (0), lastFaultPage (0),
+        reclaimStop (false), reclaimRequested (false), reclaiming (false),
+        reclaimPaused (0)
+#endif
+  {
+#ifdef VM_THREADS
+    for (int s = 0; s < TOUCH_STRIPES; ++s)
+    {
+      stripes[s].lock.clear ();
+      stripes[s].count = 0;
+    }
+#endif
+  }
+
+#ifdef VM_THREADS
+  ~FrameTable ()
+  {
+    stopReclaimer ();
+  }
+#endif
+
+  FrameTable (const FrameTable &) = delete;
+  FrameTable &operator= (const FrameTable &) = delete;
+
+  /**
+   * Attach an address space and give it a cleared root table, frame 0
+   * if it is available. Each space keeps TABLES_DEPTH frames free of
+   * roots, so a fault in any space can always complete its walk; twice
+   * that while there are origins, see fork.
+   * @return the id of the space, or -1 if no more spaces fit
+   */
+  int attach (AddressSpace<G> *space)
+  {
+    pauseReclaimer ();
+    if (rootCount + walkFrames () >= G::numFrames)
+    {
+      resumeReclaimer ();
+      return -1;
+    }
+    int id = 0;
+    while (id < (int) spaces.size ()
+           && (spaces[id] != nullptr || sharers[id] != 0))
+    {
+      ++id;
+    }
+    if ((uint64_t) id >= maxSpaces ())
+    {
+      resumeReclaimer ();
+      return -1;
+    }
+    if (id == (int) spaces.size ())
+    {
+      spaces.push_back (nullptr);
+      roots.push_back (0);
+      origins.push_back (-1);
+      sharers.push_back (0);
+    }
+    word_t root = 0;
+    if (frames[0].role != FRAME_FREE)
+    {
+      int occupied[G::tablesDepth] = {0};
+      root = findEmptyFrame (occupied, id, 0, -1);
+      if (root == swapFailed ())
+      {
+        resumeReclaimer ();
+        return -1;
+      }
+      unlockExclusive (root);
+    }
+    frames[root].role = FRAME_TABLE;
+    frames[root].layer = 0;
+    frames[root].parentTable = root;
+    frames[root].offset = 0;
+    frames[root].page = 0;
+    frames[root].space = id;
+    spaces[id] = space;
+    roots[id] = root;
+    rootCount++;
+    clear (id);
+    resumeReclaimer ();
+    return id;
+  }
+
+  // Free every frame of a space, its swapped pages and its id. An origin
+  // is detached the same way once no space shares it.
+  void detach (int space)
+  {
+    pauseReclaimer ();
+    if (pinnedCount != 0 && frames[pinnedFrame].space == space)
+    {
+      unpin ();
+    }
+    clear (space);
+    const word_t root = roots[space];
+    frames[root].role = FRAME_FREE;
+    if (root != 0)
+    {
+      recycleFrame (root);
+    }
+    memory.discardSwap (swapKey (space, 0), swapKey (space, G::numPages - 1));
+    spaces[space] = nullptr;
+    rootCount--;
+    resumeReclaimer ();
+  }
+
+  /**
+   * Forget every mapping of a space: all its frames but the root go back
+   * to the free list and the root table is cleared. Pages it swapped out
+   * stay in swap. The space no longer shares its origin's pages.
+   */
+  void clear (int space)
+  {
+    pauseReclaimer ();
+#ifdef VM_THREADS
+    // so no queued access reaches a page that takes a freed frame
+    drainTouches ();
+#endif
+    bool freed = false;
+    for (uint64_t i = 0; i < freshFrame; ++i)
+    {
+      if (frames[i].role == FRAME_FREE || frames[i].space != space
+          || frames[i].layer == 0)
+      {
+        continue;
+      }
+      if (frames[i].role == FRAME_PAGE)
+      {
+        policy->pageOut (i);
+      }
+      else if (frames[i].role == FRAME_TABLE)
+      {
+        emptyTables.erase (table_key (space, frames[i].page));
+      }
+      frames[i].role = FRAME_FREE;
+      frames[i].run = 0;
+      recycledFrames.push_back (i);
+      freed = true;
+    }
+    if (freed)
+    {
+      heapRecycledFrames ();
+    }
+    const word_t root = roots[space];
+    frames[root].liveEntries = 0;
+    memory.clearFrame (root);
+    releaseOrigin (space);
+    resumeReclaimer ();
+  }
+
+  /**
+   * Fork space 'parent': child is attached as a copy of it that shares
+   * every frame and swapped page with it, see the class comment. The
+   * work is two cleared roots however many pages are resident; a child
+   * that was attached is detached first. Each copy-on-write fault walks
+   * the origin while it holds its own path, so forks need room for two
+   * walks besides the roots.
+   * @return the id of child, or -1 with VM_THREADS or if the roots or
+   * the walks do not fit
+   */
+  int fork (int parent, AddressSpace<G> *child, int childId)
+  {
+#ifdef VM_THREADS
+    (void) parent;
+    (void) child;
+    (void) childId;
+    return -1;
+#else
+    const uint64_t added = childId < 0 ? 2 : 1;
+    if (rootCount + added + 2 * G::tablesDepth > G::numFrames)
+    {
+      return -1;
+    }
+    if (childId >= 0)
+    {
+      detach (childId);
+    }
+    AddressSpace<G> *forking = spaces[parent];
+    const int id = attach (forking);
+    const int forked = id < 0 ? -1 : attach (child);
+    if (forked < 0)
+    {
+      if (id >= 0)
+      {
+        detach (id);
+      }
+      return -1;
+    }
+    spaces[parent] = nullptr;
+    origins[id] = parent;
+    origins[forked] = parent;
+    sharers[parent] = 2;
+    originCount++;
+    forking->forked (id);
+    return forked;
+#endif
+  }
+
+  // The space whose pages a space reads where it has none, -1 if none
+  int originOf (int space) const
+  {
+    return origins[space];
+  }
+
+  // true while any space shares the pages of an origin
+  bool forked () const
+  {
+    return originCount != 0;
+  }
+
+  // Address space the frame belongs to
+  int spaceOf (word_t frame) const
+  {
+    return frames[frame].space;
+  }
+
+  // Root table of an attached space
+  word_t rootOf (int space) const
+  {
+    return roots[space];
+  }
+
+  // Number of space ids handed out, attached or not
+  uint64_t spaceIds () const
+  {
+    return spaces.size ();
+  }
+
+  bool isAttached (int space) const
+  {
+    return spaces[space] != nullptr;
+  }
+
+  /**
+   * Check the reverse map and the roots of a saved memory before
+   * loadImage takes them over: every frame in use must belong to a space
+   * id of this table and be linked from a table of the layer above at an
+   * offset within it, a huge run must fit in the RAM and every attached
+   * root must be a root table of its space.
+   */
+  bool validImage (const frame_info *info, const int64_t *savedRoots) const
+  {
+    const uint64_t ids = spaces.size ();
+    for (uint64_t i = 0; i < G::numFrames; ++i)
+    {
+      const frame_info &frame = info[i];
+      if (frame.role == FRAME_FREE)
+      {
+        continue;
+      }
+      if ((frame.role != FRAME_TABLE && frame.role != FRAME_PAGE
+           && frame.role != FRAME_HUGE)
+          || frame.space < 0 || (uint64_t) frame.space >= ids
+          || frame.layer < 0 || frame.layer > G::tablesDepth
+          || (frame.layer == G::tablesDepth) == (frame.role == FRAME_TABLE)
+          || frame.parentTable < 0
+          || (uint64_t) frame.parentTable >= G::numFrames
+          || frame.offset < 0 || (uint64_t) frame.offset >= G::pageSize
+          || frame.page >= G::numPages || frame.liveEntries < 0
+          || (uint64_t) frame.liveEntries > G::pageSize
+          || frame.run > G::numFrames - i)
+      {
+        return false;
+      }
+      const frame_info &parent = info[frame.parentTable];
+      if (frame.role == FRAME_HUGE)
+      {
+        // the rest of a run points back to its first frame
+        if ((uint64_t) frame.parentTable >= i || parent.role != FRAME_PAGE
+            || frame.parentTable + parent.run <= i)
+        {
+          return false;
+        }
+      }
+      else if (frame.layer == 0 ? (uint64_t) frame.parentTable != i
+                                : parent.role != FRAME_TABLE
+                                  || parent.layer >= frame.layer
+                                  || parent.space != frame.space)
+      {
+        return false;
+      }
+    }
+    for (uint64_t id = 0; id < ids; ++id)
+    {
+      const int64_t root = savedRoots[id];
+      if (root < -1 || root >= (int64_t) G::numFrames
+          || (root >= 0 && (info[root].role != FRAME_TABLE
+                            || info[root].layer != 0
+                            || info[root].space != (int) id)))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Take over the reverse map and the roots of a saved memory whose
+   * tables and pages are in RAM already, see PhysicalMemory::load. The
+   * same space ids are attached as when it was saved. The free list and
+   * the empty tables are rebuilt from the map, a new policy of the given
+   * kind is handed the pages in frame order and every space forgets its
+   * cached translations.
+   */
+  void loadImage (const frame_info *info, const word_t *savedRoots, int kind,
+                  bool huge)
+  {
+    pauseReclaimer ();
+    unpin ();
+    // only the frames up to the highest one in use are taken over
+    freshFrame = G::numFrames;
+    while (freshFrame > 1 && info[freshFrame - 1].role == FRAME_FREE)
+    {
+      --freshFrame;
+    }
+    frames.clear ();
+    std::copy (info, info + freshFrame, frames.data ());
+    recycledFrames.clear ();
+    emptyTables.clear ();
+    hugeUsed = false;
+    for (uint64_t i = freshFrame - 1; i > 0; --i)
+    {
+      if (frames[i].role == FRAME_FREE)
+      {
+        recycledFrames.push_back (i);
+      }
+      else if (frames[i].role == FRAME_TABLE && frames[i].layer != 0
+               && frames[i].liveEntries == 0)
+      {
+        emptyTables[table_key (frames[i].space, frames[i].page)] = i;
+      }
+      hugeUsed = hugeUsed || frames[i].run != 0;
+    }
+    heapRecycledFrames ();
+    hugeMode = huge;
+    setPolicy (kind);
+    for (size_t id = 0; id < spaces.size (); ++id)
+    {
+      if (spaces[id] != nullptr)
+      {
+        roots[id] = savedRoots[id];
+        spaces[id]->framesReloaded ();
+      }
+    }
+    resumeReclaimer ();
+  }
+
+  /**
+   * Evict by one of the POLICY_* policies from now on. The resident pages
+   * are handed to the new policy in frame order, with no history.
+   * Needs the memory to be quiescent.
+   * @return 0 if kind is not a policy
+   */
+  int setPolicy (int kind)
+  {
+    ReplacementPolicy<G> *chosen = ReplacementPolicy<G>::create (kind, frames);
+    if (chosen == nullptr)
+    {
+      return 0;
+    }
+    installPolicy (chosen);
+    policyKind = kind;
+    return 1;
+  }
+
+  // Evict by a policy of the caller's, which the frame table then owns.
+  // The policy must be built on frameInfo ().
+  void installPolicy (ReplacementPolicy<G> *chosen)
+  {
+    pauseReclaimer ();
+#ifdef VM_THREADS
+    // queued accesses go to the policy they were made under
+    drainTouches ();
+#endif
+    policy.reset (chosen);
+    policyKind = -1;
+    trackAccess = chosen->tracksAccess ();
+    for (uint64_t i = 0; i < freshFrame; ++i)
+    {
+      if (frames[i].role == FRAME_PAGE)
+      {
+        policy->pageIn (i);
+      }
+    }
+    resumeReclaimer ();
+  }
+
+  // POLICY_* kind of the current policy, -1 for one from installPolicy
+  int policyOf () const
+  {
+    return policyKind;
+  }
+
+  // the reverse map policies are built on
+  const FrameArray<frame_info> &frameInfo () const
+  {
+    return frames;
+  }
+
+  /**
+   * Tell the policy that the page in frame was accessed, if it asks.
+   * With VM_THREADS the frame is queued in the buffer of the calling
+   * thread instead, and the policy sees the buffers before its next
+   * victim, see drainTouches; only a full buffer takes the index lock.
+   * The accesses of one thread reach the policy in order, those of
+   * different threads by buffer.
+   */
+  void touch (word_t frame)
+  {
+    if (!trackAccess)
+    {
+      return;
+    }
+#ifdef VM_THREADS
+    touch_stripe &stripe = stripes[touchStripe ()];
+    for (;;)
+    {
+      lockStripe (stripe);
+      if (stripe.count < TOUCH_BUFFER)
+      {
+        stripe.queued[stripe.count++] = frame;
+        stripe.lock.clear (std::memory_order_release);
+        return;
+      }
+      stripe.lock.clear (std::memory_order_release);
+      std::lock_guard<std::mutex> guard (indexLock);
+      drainTouches ();
+    }
+#else
+    touchPolicy (frame);
+#endif
+  }
+
+  /**
+   * Fault in the pages under a missing last-level table as one huge page
+   * from now on, or stop doing so. Tables and huge pages mapped so far
+   * stay as they are.
+   * @return 0 with VM_THREADS, or if the geometry has no last-level table
+   * to leave out or no room for a run besides the one of frame 0
+   */
+  int setHugePages (bool enable)
+  {
+#ifdef VM_THREADS
+    (void) enable;
+    return 0;
+#else
+    if (enable && (G::tablesDepth < 2 || hugeRun () * 2 > G::numFrames))
+    {
+      return 0;
+    }
+    hugeMode = enable;
+    return 1;
+#endif
+  }
+
+  bool hugePages () const
+  {
+    return hugeMode;
+  }
+
+  /**
+   * Keep between low and high frames on the free list from now on: a
+   * thread of its own evicts the pages the policy chooses, as a fault
+   * would, whenever faults leave fewer than low free, until high are.
+   * Faults then mostly take a free frame. 0, 0 stops the thread.
+   * @return 0 without VM_THREADS, or if low > high or high is more than
+   * half the frames
+   */
+  int setReclaimer (uint64_t low, uint64_t high)
+  {
+#ifdef VM_THREADS
+    if (low > high || high > G::numFrames / 2)
+    {
+      return 0;
+    }
+    stopReclaimer ();
+    if (high == 0)
+    {
+      return 1;
+    }
+    lowWatermark = low;
+    highWatermark = high;
+    reclaimStop = false;
+    reclaimRequested = true;
+    reclaimer = std::thread (&FrameTable::reclaim, this);
+    return 1;
+#else
+    (void) low;
+    (void) high;
+    return 0;
+#endif
+  }
+
+  // Hold the reclaimer off until resumeReclaimer, waiting for an eviction
+  // it is in the middle of, for work that needs the memory quiescent.
+  // Calls nest.
+  void pauseReclaimer ()
+  {
+#ifdef VM_THREADS
+    std::unique_lock<std::mutex> guard (indexLock);
+    reclaimPaused++;
+    reclaimSignal.wait (guard, [this] { return !reclaiming; });
+#endif
+  }
+
+  void resumeReclaimer ()
+  {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard (indexLock);
+    if (--reclaimPaused == 0)
+    {
+      reclaimSignal.notify_all ();
+    }
+#endif
+  }
+
+  // Pages, and frames, of a huge page: those under one last-level table
+  static uint64_t hugeRun ()
+  {
+    return 1ULL << G::layerWidth (G::tablesDepth - 1);
+  }
+
+  // Flag of a table entry that maps a huge page. Frames are below
+  // numFrames, so the bit is free in every other entry.
+  static word_t hugeEntry ()
+  {
+    return (word_t) G::numFrames;
+  }
+
+  // What findEmptyFrame returns when the swap device could not store the
+  // page it was to evict. Frames are never negative.
+  static word_t swapFailed ()
+  {
+    return (word_t) -1;
+  }
+
+  // Index a page of a space is swapped under
+  static uint64_t swapKey (int space, uint64_t page)
+  {
+    return ((uint64_t) space << G::pageWidth) | page;
+  }
+
+  // Check if frame is not in the current traversal path
+  static bool notOccupied (const int *occupied, const int frame)
+  {
+    for (int i = 0; i < G::tablesDepth; ++i)
+    {
+      if (occupied[i] == frame)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Mark frame as occupied
+  static void makeOccupied (int *occupied, int frame)
+  {
+    for (int i = 0; i < G::tablesDepth; ++i)
+    {
+      if (occupied[i] == 0){
+        occupied[i] = frame;
+        break;
+      }
+    }
+  }
+
+  // Record in the reverse map that frame is now linked from parent/offset.
+  // A new table starts empty, its parent gains a live entry.
+  // Both frames are held exclusively.
+  void linkFrame (word_t frame, word_t parent, word_t offset, int layer,
+                  uint64_t page)
+  {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard (indexLock);
+#endif
+    const int space = frames[parent].space;
+    if (frames[parent].liveEntries++ == 0 && frames[parent].layer != 0)
+    {
+      emptyTables.erase (table_key (space, frames[parent].page));
+    }
+    frames[frame].role = layer < G::tablesDepth ? FRAME_TABLE : FRAME_PAGE;
+    frames[frame].layer = layer;
+    frames[frame].parentTable = parent;
+    frames[frame].offset = offset;
+    frames[frame].page = page;
+    frames[frame].liveEntries = 0;
+    frames[frame].space = space;
+    frames[frame].run = 0;
+    if (layer == G::tablesDepth)
+    {
+      policy->pageIn (frame);
+    }
+    else
+    {
+      emptyTables[table_key (space, page)] = frame;
+    }
+  }
+
+  // Take the lock of a frame for reading its words or entries
+  void lockShared (word_t frame)
+  {
+#ifdef VM_THREADS
+    std::atomic<int> &lock = locks[frame];
+    for (;;)
+    {
+      int readers = lock.load (std::memory_order_relaxed);
+      if (readers >= 0 && (readers & FRAME_LOCK_WAITING) == 0
+          && lock.compare_exchange_weak (readers, readers + 1,
+                                         std::memory_order_acquire))
+      {
+        return;
+      }
+      std::this_thread::yield ();
+    }
+#else
+    (void) frame;
+#endif
+  }
+
+  void unlockShared (word_t frame)
+  {
+#ifdef VM_THREADS
+    locks[frame].fetch_sub (1, std::memory_order_release);
+#else
+    (void) frame;
+#endif
+  }
+
+  // Take the lock of a frame for changing it. Only called while holding
+  // no other lock, or for a free frame that nobody else can wait for.
+  void lockExclusive (word_t frame)
+  {
+#ifdef VM_THREADS
+    std::atomic<int> &lock = locks[frame];
+    for (;;)
+    {
+      // a lock held exclusively is -1, setting the bit leaves it as it is
+      lock.fetch_or (FRAME_LOCK_WAITING, std::memory_order_relaxed);
+      int waiting = FRAME_LOCK_WAITING;
+      if (lock.compare_exchange_weak (waiting, -1, std::memory_order_acquire))
+      {
+        return;
+      }
+      std::this_thread::yield ();
+    }
+#else
+    (void) frame;
+#endif
+  }
+
+  bool tryLockExclusive (word_t frame)
+  {
+#ifdef VM_THREADS
+    int unlocked = 0;
+    return locks[frame].compare_exchange_strong (unlocked, -1,
+                                                 std::memory_order_acquire);
+#else
+    (void) frame;
+    return true;
+#endif
+  }
+
+  void unlockExclusive (word_t frame)
+  {
+#ifdef VM_THREADS
+    locks[frame].store (0, std::memory_order_release);
+#else
+    (void) frame;
+#endif
+  }
+
+  // Turn an exclusive lock into a shared one without letting go
+  void downgrade (word_t frame)
+  {
+#ifdef VM_THREADS
+    locks[frame].store (1, std::memory_order_release);
+#else
+    (void) frame;
+#endif
+  }
+
+  /**
+   * Turn a shared lock on a table into an exclusive one. The lock is let
+   * go in between, so the table may have been reclaimed meanwhile: it is
+   * checked to still be the table at layer over prefix of space.
+   * @return false, with the lock released, if it is not
+   */
+  bool upgrade (word_t table, int space, int layer, uint64_t prefix)
+  {
+#ifdef VM_THREADS
+    unlockShared (table);
+    lockExclusive (table);
+    if (frames[table].role == FRAME_TABLE && frames[table].space == space
+        && frames[table].layer == layer && frames[table].page == prefix)
+    {
+      return true;
+    }
+    unlockExclusive (table);
+    return false;
+#else
+    (void) table;
+    (void) space;
+    (void) layer;
+    (void) prefix;
+    return true;
+#endif
+  }
+
+  // true if frame currently holds page of space
+  bool holdsPage (uint64_t frame, int space, uint64_t page) const
+  {
+    return (frames[frame].role == FRAME_PAGE
+            || frames[frame].role == FRAME_HUGE)
+           && frames[frame].page == page && frames[frame].space == space;
+  }
+
+  /**
+   * Find hugeRun () aligned frames for a huge page under 'held', the
+   * table the walk holds: the run that costs the fewest evictions, ties
+   * to the lower frames. Runs with a root, a table that is not empty, a
+   * table on the path or the pinned page are passed over, and so is the
+   * run of frame 0. The run is emptied: free frames are taken off the
+   * free list, empty tables reclaimed and the pages in it evicted.
+   * Huge pages are not available with VM_THREADS, so nothing is locked.
+   * @return the first frame of the run, 0 if every run is passed over or
+   * the swap device could not store a page of it; the frames it freed
+   * then go to the free list
+   */
+  word_t findHugeRun (const int *occupied, word_t held)
+  {
+    const uint64_t run = hugeRun ();
+    word_t best = 0;
+    uint64_t bestCost = run + 1;
+    for (uint64_t base = run; base < G::numFrames; base += run)
+    {
+      uint64_t cost = 0;
+      for (uint64_t f = base; f < base + run && cost < bestCost; ++f)
+      {
+        const frame_info &info = frames[f];
+        if (!notOccupied (occupied, f)
+            || (pinnedCount != 0 && f == (uint64_t) pinnedFrame)
+            || (info.role == FRAME_TABLE
+                && (info.layer == 0 || info.liveEntries != 0)))
+        {
+          cost = bestCost;
+        }
+        else if (info.role == FRAME_PAGE || info.role == FRAME_HUGE)
+        {
+          cost++;
+        }
+      }
+      if (cost < bestCost)
+      {
+        best = base;
+        bestCost = cost;
+      }
+    }
+    if (best == 0)
+    {
+      return 0;
+    }
+    std::vector<word_t> freed;
+    for (word_t f = best; f < (word_t) (best + run); ++f)
+    {
+      if (frames[f].role == FRAME_TABLE)
+      {
+        reclaimTable (f, held);
+        freed.push_back (f);
+      }
+      else if (frames[f].role == FRAME_PAGE)
+      {
+        // a huge page in the run starts at best and frees the rest of it
+        const frame_info was = frames[f];
+        unlinkFrame (f);
+        if (!evictUnlinked (f, was, held))
+        {
+          relinkFrame (f, was);
+          for (size_t i = 0; i < freed.size (); ++i)
+          {
+            recycleFrame (freed[i]);
+          }
+          framesReturned = true;
+          return 0;
+        }
+        for (uint64_t i = 0; i < std::max<uint64_t> (was.run, 1); ++i)
+        {
+          freed.push_back (f + i);
+        }
+      }
+    }
+    const size_t listed = freeCount ();
+    recycledFrames.erase (std::remove_if (recycledFrames.begin (),
+                                          recycledFrames.end (),
+                                          [best, run] (word_t f) {
+                                            return f >= best
+                                                   && (uint64_t) f
+                                                      < best + run;
+                                          }),
+                          recycledFrames.end ());
+    if (best + run > freshFrame)
+    {
+      // the frames never handed out below the run stay free
+      for (word_t f = (word_t) freshFrame; f < best; ++f)
+      {
+        recycledFrames.push_back (f);
+      }
+      freshFrame = best + run;
+    }
+    heapRecycledFrames ();
+    for (size_t i = freeCount (); i < listed; ++i)
+    {
+      memory.stats ().recordFreeFrame ();
+    }
+    hugeUsed = true;
+    return best;
+  }
+
+  // Record in the reverse map that the run from base holds a huge page
+  // from 'page' on, linked from parent/offset
+  void linkHuge (word_t base, word_t parent, word_t offset, uint64_t page)
+  {
+    const int space = frames[parent].space;
+    if (frames[parent].liveEntries++ == 0 && frames[parent].layer != 0)
+    {
+      emptyTables.erase (table_key (space, frames[parent].page));
+    }
+    const uint64_t run = hugeRun ();
+    for (uint64_t i = 0; i < run; ++i)
+    {
+      frame_info &info = frames[base + i];
+      info.role = i == 0 ? FRAME_PAGE : FRAME_HUGE;
+      info.layer = G::tablesDepth;
+      info.parentTable = i == 0 ? parent : base;
+      info.offset = offset;
+      info.page = page + i;
+      info.liveEntries = 0;
+      info.space = space;
+      info.run = i == 0 ? run : 0;
+    }
+    policy->pageIn (base);
+  }
+
+  // Keep the page in frame out of the eviction candidates until unpin.
+  // It is evicted all the same if nothing else can be.
+  void pin (word_t frame)
+  {
+    pinnedFrame = frame;
+    pinnedCount = 1;
+  }
+
+  void unpin ()
+  {
+    pinnedCount = 0;
+  }
+
+  /**
+   * Find available frame using three-tier strategy:
+   * 1. Reuse the first empty table
+   * 2. Allocate new unused frame if available
+   * 3. Evict the page the replacement policy chooses for the fault on
+   *    'page_swapped_in' of 'space', by default the one with maximum
+   *    cyclic distance
+   * Every tier is answered from the reverse map indexes without walking
+   * the tables: frames come off the free list in the order maxFrame+1
+   * would hand them out. Taking the free list below the low watermark
+   * wakes the reclaimer, if there is one.
+   * A reused table is empty, so no cached translation goes through it;
+   * an evicted page is dropped from the translation cache of its space.
+   * Evicting a huge page frees its whole run: the first frame is
+   * returned, the others go to the free list.
+   * The frame is returned locked exclusively. 'held' is the table the
+   * caller holds exclusively, -1 if none.
+   * @return 0 if every candidate is busy in another thread, swapFailed ()
+   * if the swap device could not store the victim page, which then stays
+   * where it was
+   */
+  word_t findEmptyFrame (int *occupied, int space, uint64_t page_swapped_in,
+                         word_t held)
+  {
+#ifdef VM_THREADS
+    std::unique_lock<std::mutex> guard (indexLock);
+#endif
+#ifdef VM_CHECK_INDEX
+    checkIndexes (occupied, page_swapped_in);
+#endif
+#ifdef VM_THREADS
+    lastFaultSpace = space;
+    lastFaultPage = page_swapped_in;
+#endif
+    word_t frame = peekEmptyTable (occupied, held);
+    if (frame != 0){
+      reclaimTable (frame, held);
+      makeOccupied (occupied, frame);
+      return frame;
+    }
+    frame = takeFreeFrame ();
+    if (frame != 0){
+      memory.stats ().recordFreeFrame ();
+      wakeReclaimer ();
+      lockExclusive (frame);
+      makeOccupied (occupied, frame);
+      return frame;
+    }
+    wakeReclaimer ();
+#ifdef VM_THREADS
+    drainTouches ();
+#endif
+    // the pinned page is busy, unless it is the only page left
+    std::vector<word_t> busy;
+    bool skipPinned = pinnedCount != 0;
+    if (skipPinned)
+    {
+      busy.push_back (pinnedFrame);
+    }
+    word_t victim;
+    for (;;)
+    {
+      victim = policy->victim (space, page_swapped_in, busy);
+      if (victim == 0 && skipPinned)
+      {
+        // start over with the pinned page, or the huge page holding it
+        skipPinned = false;
+        busy.clear ();
+        continue;
+      }
+      if (victim == 0)
+      {
+        return 0;
+      }
+      if (skipPinned && pinnedFrame > victim
+          && (uint64_t) pinnedFrame < victim + frames[victim].run)
+      {
+        busy.push_back (victim);
+        continue;
+      }
+      if (takeFrame (victim, held))
+      {
+        break;
+      }
+      busy.push_back (victim);
+    }
+    const frame_info was = frames[victim];
+    unlinkFrame (victim);
+#ifdef VM_THREADS
+    guard.unlock ();
+#endif
+    if (!evictUnlinked (victim, was, held))
+    {
+#ifdef VM_THREADS
+      guard.lock ();
+#endif
+      relinkFrame (victim, was);
+      unlockExclusive (victim);
+      return swapFailed ();
+    }
+    // the rest of a huge page is free; huge pages are not available with
+    // VM_THREADS, so the indexes need no lock
+    if (was.run > 1)
+    {
+      for (uint64_t i = 1; i < was.run; ++i)
+      {
+        recycleFrame (victim + i);
+      }
+    }
+    makeOccupied (occupied, victim);
+    return victim;
+  }
+
+  // Give back frames that were handed out but could not be filled: the
+  // frame of findEmptyFrame, locked, or the run of findHugeRun. They go to
+  // the free list unlocked.
+  void releaseFrames (word_t first, uint64_t count)
+  {
+    {
+#ifdef VM_THREADS
+      std::lock_guard<std::mutex> guard (indexLock);
+#endif
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        recycleFrame (first + i);
+      }
+      framesReturned = true;
+    }
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      unlockExclusive (first + i);
+    }
+  }
+
+private:
+#ifdef VM_THREADS
+  // frames accessed since the policy last saw them, see touch
+  struct touch_stripe
+  {
+    std::atomic_flag lock;
+    uint64_t count;
+    word_t queued[TOUCH_BUFFER];
+  };
+#endif
+
+  // empty tables are ordered by space, then by the first page under them
+  typedef std::pair<int, uint64_t> table_key;
+  typedef std::map<table_key, word_t>::const_iterator table_iter;
+
+  // number of spaces whose swap indexes fit in 64 bits
+  static uint64_t maxSpaces ()
+  {
+    return G::pageWidth > 32 ? 1ULL << (64 - G::pageWidth) : 1ULL << 32;
+  }
+
+  // frames kept free of roots so the walks of a fault can complete
+  uint64_t walkFrames () const
+  {
+    return originCount != 0 ? 2 * G::tablesDepth : G::tablesDepth;
+  }
+
+  // The space stops sharing its origin, which goes once nobody does
+  void releaseOrigin (int space)
+  {
+    const int origin = origins[space];
+    origins[space] = -1;
+    if (origin >= 0 && --sharers[origin] == 0)
+    {
+      originCount--;
+      detach (origin);
+    }
+  }
+
+  // Put a frame on the free list
+  void recycleFrame (word_t frame)
+  {
+    recycledFrames.push_back (frame);
+    std::push_heap (recycledFrames.begin (), recycledFrames.end (),
+                    std::greater<word_t> ());
+  }
+
+  // Make the free list a heap again after frames were added or removed
+  // in bulk
+  void heapRecycledFrames ()
+  {
+    std::make_heap (recycledFrames.begin (), recycledFrames.end (),
+                    std::greater<word_t> ());
+  }
+
+  // Frames on the free list: the recycled ones and those never handed out
+  uint64_t freeCount () const
+  {
+    return recycledFrames.size () + (G::numFrames - freshFrame);
+  }
+
+  // The lowest free frame, numFrames if there is none. Recycled frames
+  // were all handed out, so they lie below freshFrame.
+  word_t lowestFree () const
+  {
+    return recycledFrames.empty () ? (word_t) freshFrame
+                                   : recycledFrames.front ();
+  }
+
+  // Take the lowest free frame off the free list, 0 if there is none
+  word_t takeFreeFrame ()
+  {
+    if (!recycledFrames.empty ())
+    {
+      std::pop_heap (recycledFrames.begin (), recycledFrames.end (),
+                     std::greater<word_t> ());
+      const word_t frame = recycledFrames.back ();
+      recycledFrames.pop_back ();
+      return frame;
+    }
+    if (freshFrame < G::numFrames)
+    {
+      return (word_t) freshFrame++;
+    }
+    return 0;
+  }
+
+  // Record in the reverse map that a frame was unlinked from its parent.
+  // The parent loses a live entry and may become a reusable empty table.
+  void unlinkFrame (word_t frame)
+  {
+    const word_t parent = frames[frame].parentTable;
+    const int space = frames[frame].space;
+    if (frames[frame].role == FRAME_PAGE)
+    {
+      policy->pageOut (frame);
+    }
+    else
+    {
+      emptyTables.erase (table_key (space, frames[frame].page));
+    }
+    frames[frame].role = FRAME_FREE;
+    for (uint64_t i = 1; i < frames[frame].run; ++i)
+    {
+      frames[frame + i].role = FRAME_FREE;
+    }
+    frames[frame].run = 0;
+    if (--frames[parent].liveEntries == 0 && frames[parent].layer != 0)
+    {
+      emptyTables[table_key (space, frames[parent].page)] = parent;
+    }
+  }
+
+  // Swap out the page, or the pages of the huge page, that 'was' says
+  // victim held before unlinkFrame, and clear its entry in the parent.
+  // Returns false, with the pages still mapped, if the swap device could
+  // not store one of them; the parent is unlocked either way.
+  bool evictUnlinked (word_t victim, const frame_info &was, word_t held)
+  {
+    const uint64_t run = std::max<uint64_t> (was.run, 1);
+    for (uint64_t i = 0; i < run; ++i)
+    {
+      if (!memory.evict (victim + i, swapKey (was.space, was.page + i)))
+      {
+        if (was.parentTable != held)
+        {
+          unlockExclusive (was.parentTable);
+        }
+        return false;
+      }
+    }
+    for (uint64_t i = 0; i < run; ++i)
+    {
+      if (spaces[was.space] != nullptr)
+      {
+        spaces[was.space]->pageEvicted (was.page + i, victim + i);
+        continue;
+      }
+      // a page of an origin may be cached by any space forked from it
+      for (size_t id = 0; id < spaces.size (); ++id)
+      {
+        if (spaces[id] != nullptr)
+        {
+          spaces[id]->pageEvicted (was.page + i, victim + i);
+        }
+      }
+    }
+    memory.write ((was.parentTable * G::pageSize) + was.offset, 0);
+    if (was.parentTable != held)
+    {
+      unlockExclusive (was.parentTable);
+    }
+    return true;
+  }
+
+  // Undo unlinkFrame of a page that could not be evicted: 'was' is what
+  // the frame held. The policy sees it come in again.
+  void relinkFrame (word_t frame, const frame_info &was)
+  {
+    const word_t parent = was.parentTable;
+    if (frames[parent].liveEntries++ == 0 && frames[parent].layer != 0)
+    {
+      emptyTables.erase (table_key (was.space, frames[parent].page));
+    }
+    frames[frame] = was;
+    for (uint64_t i = 1; i < was.run; ++i)
+    {
+      frames[frame + i].role = FRAME_HUGE;
+    }
+    policy->pageIn (frame);
+  }
+
+  // Pass an access on to the policy, which sees a huge page as its first
+  // frame
+  void touchPolicy (word_t frame)
+  {
+    if (frames[frame].role == FRAME_HUGE)
+    {
+      frame = frames[frame].parentTable;
+    }
+    policy->touch (frame);
+  }
+
+#ifdef VM_THREADS
+  // the touch buffer of the calling thread
+  static int touchStripe ()
+  {
+    static std::atomic<int> threads (0);
+    static thread_local int stripe = threads++ % TOUCH_STRIPES;
+    return stripe;
+  }
+
+  void lockStripe (touch_stripe &stripe)
+  {
+    while (stripe.lock.test_and_set (std::memory_order_acquire))
+    {
+      std::this_thread::yield ();
+    }
+  }
+
+  // Hand the queued accesses to the policy. A frame may have been evicted
+  // or reused since it was queued: a table or free frame is skipped, a
+  // page that took its place counts as accessed. Called with indexLock
+  // held, or with the memory quiescent.
+  void drainTouches ()
+  {
+    for (int s = 0; s < TOUCH_STRIPES; ++s)
+    {
+      touch_stripe &stripe = stripes[s];
+      lockStripe (stripe);
+      for (uint64_t i = 0; i < stripe.count; ++i)
+      {
+        const word_t frame = stripe.queued[i];
+        if (frames[frame].role == FRAME_PAGE
+            || frames[frame].role == FRAME_HUGE)
+        {
+          touchPolicy (frame);
+        }
+      }
+      stripe.count = 0;
+      stripe.lock.clear (std::memory_order_release);
+    }
+  }
+
+  // Ask the reclaimer for frames if the free list is below the low
+  // watermark. Called with indexLock held.
+  void wakeReclaimer ()
+  {
+    if (highWatermark != 0 && freeCount () < lowWatermark
+        && !reclaimRequested)
+    {
+      reclaimRequested = true;
+      reclaimSignal.notify_all ();
+    }
+  }
+
+  void stopReclaimer ()
+  {
+    if (!reclaimer.joinable ())
+    {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> guard (indexLock);
+      reclaimStop = true;
+      highWatermark = 0;
+    }
+    reclaimSignal.notify_all ();
+    reclaimer.join ();
+  }
+
+  // The reclaimer thread: once asked, evict victims of the policy, for the
+  // last page that faulted, until the free list is at the high watermark
+  // or every page left is busy. Victims are try-locked with their parent
+  // like in findEmptyFrame, and the indexes are let go across the swap
+  // I/O.
+  void reclaim ()
+  {
+    std::unique_lock<std::mutex> guard (indexLock);
+    for (;;)
+    {
+      reclaimSignal.wait (guard, [this] {
+        return reclaimStop || (reclaimRequested && reclaimPaused == 0);
+      });
+      if (reclaimStop)
+      {
+        return;
+      }
+      reclaimRequested = false;
+      std::vector<word_t> busy;
+      while (!reclaimStop && reclaimPaused == 0
+             && freeCount () < highWatermark)
+      {
+        drainTouches ();
+        const word_t victim = policy->victim (lastFaultSpace, lastFaultPage,
+                                              busy);
+        if (victim == 0)
+        {
+          break;
+        }
+        if (!takeFrame (victim, -1))
+        {
+          busy.push_back (victim);
+          continue;
+        }
+        const frame_info was = frames[victim];
+        unlinkFrame (victim);
+        reclaiming = true;
+        guard.unlock ();
+        const bool evicted = evictUnlinked (victim, was, -1);
+        guard.lock ();
+        reclaiming = false;
+        if (!evicted)
+        {
+          // the faults will find out about the swap device themselves
+          relinkFrame (victim, was);
+          unlockExclusive (victim);
+          reclaimSignal.notify_all ();
+          break;
+        }
+        memory.stats ().recordReclaimEviction ();
+        recycleFrame (victim);
+        unlockExclusive (victim);
+        reclaimSignal.notify_all ();
+      }
+    }
+  }
+#else
+  void wakeReclaimer ()
+  {
+  }
+#endif
+
+  // Lock a frame and its parent table exclusively, unless another thread
+  // holds either. The parent may be the table the caller already holds.
+  bool takeFrame (word_t frame, word_t held)
+  {
+    if (!tryLockExclusive (frame))
+    {
+      return false;
+    }
+    const word_t parent = frames[frame].parentTable;
+    if (parent != held && !tryLockExclusive (parent))
+    {
+      unlockExclusive (frame);
+      return false;
+    }
+    return true;
+  }
+
+  // First empty table that is not on the current path, 0 if there is none.
+  // Tables on the path are the only empty ones that are skipped, so this
+  // looks at no more than TABLES_DEPTH entries. With VM_THREADS tables
+  // busy in other threads are skipped too; the table and its parent are
+  // returned locked.
+  word_t peekEmptyTable (const int *occupied, word_t held)
+  {
+    for (table_iter it = emptyTables.begin (); it != emptyTables.end (); ++it)
+    {
+      if (notOccupied (occupied, it->second) && takeFrame (it->second, held))
+      {
+        return it->second;
+      }
+    }
+    return 0;
+  }
+
+  // Detach an empty table from its parent so it can be reused
+  void reclaimTable (word_t frame, word_t held)
+  {
+    const word_t parent = frames[frame].parentTable;
+    memory.write ((parent * G::pageSize) + frames[frame].offset, 0);
+    unlinkFrame (frame);
+    memory.stats ().recordTableReuse ();
+    if (parent != held)
+    {
+      unlockExclusive (parent);
+    }
+  }
+
+  // Live entries of a table from entry 'first' on, at most 64, as a mask
+  uint64_t liveMask (word_t table, uint64_t first)
+  {
+    return memory.nonZeroWords (table * G::pageSize + first,
+                                std::min<uint64_t> (64, G::pageSize - first));
+  }
+
+  /**
+   * One depth-first walk of the tables under root for the page with
+   * maximum cyclic distance to page_swapped_in (the first one on ties),
+   * the maximum frame number linked and the first completely empty table
+   * that is not on the path, 0 if none. Each table is read 64 entries at
+   * a time into a mask of its live ones, so only those are visited, and
+   * their number must be the liveEntries of the table. The walk keeps its
+   * own stack of tables, one per layer.
+   */
+  void scanTables (word_t root, const int *occupied, uint64_t page_swapped_in,
+                   dfs_attributes *attributes)
+  {
+    // a table on the stack, the live entries left of the 64 from chunk
+    // on, the first page under it and the live entries visited
+    struct table_cursor
+    {
+      word_t frame;
+      uint64_t chunk;
+      uint64_t live;
+      uint64_t prefix;
+      int visited;
+    };
+    table_cursor stack[G::tablesDepth];
+    stack[0] = {root, 0, liveMask (root, 0), 0, 0};
+    int layer = 0;
+    while (layer >= 0)
+    {
+      table_cursor &top = stack[layer];
+      if (top.live == 0)
+      {
+        top.chunk += 64;
+        if (top.chunk < G::pageSize)
+        {
+          top.live = liveMask (top.frame, top.chunk);
+          continue;
+        }
+        assert (top.visited == frames[top.frame].liveEntries);
+        if (top.visited == 0 && layer > 0 && attributes->emptyTable == 0
+            && notOccupied (occupied, top.frame))
+        {
+          attributes->emptyTable = top.frame;
+        }
+        --layer;
+        continue;
+      }
+      const uint64_t i = top.chunk + __builtin_ctzll (top.live);
+      top.live &= top.live - 1;
+      top.visited++;
+      const word_t value = *memory.data ((top.frame * G::pageSize) + i);
+      const uint64_t page = top.prefix + (i << G::layerShift (layer));
+      if (attributes->maxFrame < value)
+      {
+        attributes->maxFrame = value;
+      }
+      if (layer < G::tablesDepth - 1)
+      {
+        stack[++layer] = {value, 0, liveMask (value, 0), page, 0};
+        continue;
+      }
+      uint64_t x = CyclicPolicy<G>::minCyclic (page_swapped_in, page);
+      if (x > attributes->maxDistance)
+      {
+        attributes->maxDistance = x;
+        attributes->cyclicFrame = value;
+        attributes->parentTable = top.frame;
+        attributes->offset = i;
+        attributes->cyclicPage = page;
+      }
+    }
+  }
+
+#ifdef VM_CHECK_INDEX
+  // Checked builds: with one address space attached the indexes must
+  // agree with a full walk of its tables. The free list order is only
+  // checked while no other space ever shared the frames and no frame was
+  // given back after a swap failure, the victim only for the cyclic
+  // policy while no page is pinned. The walks read the tables without
+  // locks, so checked builds are for one thread. The walk does not know
+  // huge entries, so nothing is checked once one was mapped.
+  void checkIndexes (const int *occupied, uint64_t page_swapped_in)
+  {
+    if (rootCount != 1 || hugeUsed)
+    {
+      return;
+    }
+    int space = 0;
+    while (spaces[space] == nullptr)
+    {
+      ++space;
+    }
+    dfs_attributes walked = {0};
+    scanTables (roots[space], occupied, page_swapped_in, &walked);
+    assert (walked.emptyTable == peekEmptyTable (occupied, -1));
+    if (spaces.size () == 1 && !framesReturned)
+    {
+      assert (walked.maxFrame + 1 == lowestFree ());
+    }
+    if (pinnedCount != 0 || policyKind != POLICY_CYCLIC)
+    {
+      // the walk knows nothing of pinned pages or other policies
+      return;
+    }
+    const word_t indexed = policy->victim (space, page_swapped_in,
+                                           std::vector<word_t> ());
+    assert (walked.cyclicFrame == indexed);
+    if (indexed != 0)
+    {
+      assert (walked.cyclicPage == frames[indexed].page);
+      assert (walked.parentTable == frames[indexed].parentTable);
+      assert (walked.offset == frames[indexed].offset);
+    }
+  }
+#endif
+
+  PhysicalMemory<G> &memory;
+
+  // reserved only, committed as frames are first handed out; entries from
+  // freshFrame on are all FRAME_FREE
+  FrameArray<frame_info> frames;
+  // chooses the page to evict, sees every page come in and go out
+  std::unique_ptr<ReplacementPolicy<G> > policy;
+  int policyKind;
+  // true if the policy wants to see every access
+  bool trackAccess;
+  // empty tables other than the roots, within a space in the order the
+  // tree walk visits them
+  std::map<table_key, word_t> emptyTables;
+  // The free list: frames not linked anywhere. Those from freshFrame on
+  // were never handed out; the others are recycled, in a heap with the
+  // lowest frame at the front. Frame 0 is kept for a root table and never
+  // listed
+  std::vector<word_t> recycledFrames;
+  uint64_t freshFrame;
+
+  // attached spaces and their root tables by id, nullptr once detached
+  // and for origins
+  std::vector<AddressSpace<G> *> spaces;
+  std::vector<word_t> roots;
+  uint64_t rootCount;
+  // by id: the origin of the space, -1 if none, and the number of spaces
+  // and origins whose origin it is; see fork
+  std::vector<int> origins;
+  std::vector<int> sharers;
+  uint64_t originCount;
+
+  // frame of the page kept resident by a copy, if pinnedCount is 1
+  word_t pinnedFrame;
+  int pinnedCount;
+
+  // true while faults map huge pages, see setHugePages
+  bool hugeMode;
+  // true once a huge page was mapped
+  bool hugeUsed;
+  // true once frames went back to the free list after the swap device
+  // failed, out of the order the tables would hand them out
+  bool framesReturned;
+
+#ifdef VM_THREADS
+  // one lock word per frame, see lockShared; zero bytes are unlocked
+  FrameArray<std::atomic<int> > locks;
+  // guards the indexes, the policy, the free list and the pinned page
+  std::mutex indexLock;
+  // accesses the policy has not seen yet, see touch
+  touch_stripe stripes[TOUCH_STRIPES];
+
+  // background reclaimer, see setReclaimer; the fields are guarded by
+  // indexLock and highWatermark is 0 while there is none
+  std::thread reclaimer;
+  std::condition_variable reclaimSignal;
+  uint64_t lowWatermark;
+  uint64_t highWatermark;
+  // the last fault, whose page the policy picks victims for
+  int lastFaultSpace;
+  uint64_t lastFaultPage;
+  bool reclaimStop;
+  bool reclaimRequested;
+  // true while the reclaimer evicts with indexLock let go
+  bool reclaiming;
+  int reclaimPaused;
+#endif
+};
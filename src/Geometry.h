@@ -0,0 +1,111 @@
+#pragma once
+
+#include "MemoryConstants.h"
+
+/*
+ * Compile-time description of a memory geometry.
+ *
+ * All sizes, shifts and masks are constexpr, so an AddressSpace<Geometry>
+ * translates addresses with constants only, and several geometries can
+ * coexist in one program. The names mirror MemoryConstants.h.
+ *
+ * The page number is split between the TABLES_DEPTH tables from the top
+ * bit down; when it does not split evenly the first tables take one
+ * extra bit each.
+ */
+template <int OffsetWidth, int PhysicalAddressWidth, int VirtualAddressWidth>
+struct Geometry
+{
+  static_assert (OffsetWidth > 0, "a page holds at least two words");
+  static_assert (VirtualAddressWidth > OffsetWidth,
+                 "virtual addresses need at least one page number bit");
+  static_assert (PhysicalAddressWidth > OffsetWidth,
+                 "physical memory holds at least two frames");
+  static_assert (VirtualAddressWidth < 64,
+                 "virtual addresses are narrower than 64 bits");
+  static_assert (PhysicalAddressWidth <= 60,
+                 "the RAM and its zero frame fit in 64-bit byte addresses");
+  static_assert (PhysicalAddressWidth - OffsetWidth + 2
+                 <= (int) (sizeof (word_t) * CHAR_BIT),
+                 "a table entry holds a frame number and the huge page flag;"
+                 " build with -DVM_WORD64 for more frames");
+
+  // number of bits in the offset
+  static constexpr int offsetWidth = OffsetWidth;
+  // number of bits in a physical address
+  static constexpr int physicalAddressWidth = PhysicalAddressWidth;
+  // number of bits in a virtual address
+  static constexpr int virtualAddressWidth = VirtualAddressWidth;
+  // number of bits in a page number
+  static constexpr int pageWidth = VirtualAddressWidth - OffsetWidth;
+
+  // page/frame size in words, also the number of entries in a table
+  static constexpr uint64_t pageSize = 1ULL << OffsetWidth;
+  // RAM size in words
+  static constexpr uint64_t ramSize = 1ULL << PhysicalAddressWidth;
+  // virtual memory size in words
+  static constexpr uint64_t virtualMemorySize = 1ULL << VirtualAddressWidth;
+  // number of frames in the RAM
+  static constexpr uint64_t numFrames = ramSize / pageSize;
+  // number of pages in the virtual memory
+  static constexpr uint64_t numPages = 1ULL << pageWidth;
+  // number of tables on the path to a page
+  static constexpr int tablesDepth = (pageWidth + OffsetWidth - 1) / OffsetWidth;
+
+  // number of page number bits translated by the table at 'layer'
+  static constexpr int layerWidth (int layer)
+  {
+    return pageWidth / tablesDepth + (layer < pageWidth % tablesDepth ? 1 : 0);
+  }
+
+  // position of the lowest page number bit translated at 'layer'
+  static constexpr int layerShift (int layer)
+  {
+    return layer >= tablesDepth - 1
+           ? 0 : layerShift (layer + 1) + layerWidth (layer + 1);
+  }
+
+  // mask of a table index at 'layer', after shifting
+  static constexpr uint64_t layerMask (int layer)
+  {
+    return (1ULL << layerWidth (layer)) - 1;
+  }
+
+  // entry of the table at 'layer' that leads to 'page'
+  static constexpr uint64_t tableIndex (int layer, uint64_t page)
+  {
+    return (page >> layerShift (layer)) & layerMask (layer);
+  }
+
+  // first page under the table at 'layer' that leads to 'page'
+  static constexpr uint64_t tablePrefix (int layer, uint64_t page)
+  {
+    return layer == 0 ? 0 : (page >> layerShift (layer - 1))
+                            << layerShift (layer - 1);
+  }
+
+  // the values above for one table level, forced to compile time
+  template <int Layer>
+  struct Level
+  {
+    static constexpr int shift = layerShift (Layer);
+    static constexpr uint64_t mask = layerMask (Layer);
+    static constexpr int prefixShift = Layer == 0 ? pageWidth
+                                                  : layerShift (Layer - 1);
+  };
+};
+
+template <int O, int P, int V> constexpr int Geometry<O, P, V>::offsetWidth;
+template <int O, int P, int V> constexpr int Geometry<O, P, V>::physicalAddressWidth;
+template <int O, int P, int V> constexpr int Geometry<O, P, V>::virtualAddressWidth;
+template <int O, int P, int V> constexpr int Geometry<O, P, V>::pageWidth;
+template <int O, int P, int V> constexpr uint64_t Geometry<O, P, V>::pageSize;
+template <int O, int P, int V> constexpr uint64_t Geometry<O, P, V>::ramSize;
+template <int O, int P, int V> constexpr uint64_t Geometry<O, P, V>::virtualMemorySize;
+template <int O, int P, int V> constexpr uint64_t Geometry<O, P, V>::numFrames;
+template <int O, int P, int V> constexpr uint64_t Geometry<O, P, V>::numPages;
+template <int O, int P, int V> constexpr int Geometry<O, P, V>::tablesDepth;
+
+// the geometry configured in MemoryConstants.h, used by the VM* functions
+typedef Geometry<OFFSET_WIDTH, PHYSICAL_ADDRESS_WIDTH, VIRTUAL_ADDRESS_WIDTH>
+    DefaultGeometry;
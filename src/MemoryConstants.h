@@ -3,8 +3,13 @@
 #include <climits>
 #include <stdint.h>
 
-// word
+// word, also a table entry holding a frame number. -DVM_WORD64 makes it
+// 64 bits wide, for geometries with more frames than 32-bit entries hold
+#ifdef VM_WORD64
+typedef int64_t word_t;
+#else
 typedef int word_t;
+#endif
 
 #define WORD_WIDTH (sizeof(word_t) * CHAR_BIT)
 
@@ -0,0 +1,126 @@
+#include "PageCodec.h"
+#include "WordScan.h"
+#include <cstring>
+
+// A PACK_DELTA page is a sequence of runs of equal differences between
+// neighbouring words, the word before the first one taken as 0. A run is
+// the varint of (zigzag(difference) << 1 | more), followed by the varint
+// of length - 2 when 'more' is set. Zeroed stretches, counters and
+// small values thus take a byte or two per run or word.
+
+
+static uint64_t zigzag(uint64_t difference) {
+    return (difference << 1) ^ (uint64_t) ((int64_t) difference >> 63);
+}
+
+static uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// appends a varint, returns false if it does not fit before 'limit'
+static bool putVarint(unsigned char* out, uint64_t limit, uint64_t* position,
+                      uint64_t value) {
+    do {
+        if (*position == limit)
+            return false;
+        out[(*position)++] = (unsigned char) ((value & 0x7f)
+                                              | (value > 0x7f ? 0x80 : 0));
+        value >>= 7;
+    } while (value != 0);
+    return true;
+}
+
+// reads a varint that ends before 'limit', returns false if it does not
+// or if it is wider than 64 bits
+static bool getVarint(const unsigned char* in, uint64_t limit,
+                      uint64_t* position, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*position == limit)
+            return false;
+        const unsigned char byte = in[(*position)++];
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// the word as a signed 64-bit value, so differences wrap the same way back
+static uint64_t widen(word_t word) {
+    return (uint64_t) (int64_t) word;
+}
+
+int packPage(const word_t* page, uint64_t words, unsigned char* out,
+             uint64_t* bytes, word_t* same) {
+    if (allWordsEqual(page, words, page[0])) {
+        *same = page[0];
+        return PACK_SAME;
+    }
+
+    const uint64_t limit = words * sizeof(word_t) - 1;
+    uint64_t position = 0;
+    uint64_t previous = 0;
+    for (uint64_t i = 0; i < words; ) {
+        const uint64_t difference = widen(page[i]) - previous;
+        uint64_t length = 1;
+        previous = widen(page[i]);
+        while (i + length < words
+               && widen(page[i + length]) - previous == difference) {
+            previous = widen(page[i + length]);
+            length++;
+        }
+        const uint64_t value = zigzag(difference);
+        if ((value >> 63) != 0
+            || !putVarint(out, limit, &position,
+                          (value << 1) | (length > 1 ? 1 : 0))
+            || (length > 1
+                && !putVarint(out, limit, &position, length - 2))) {
+            memcpy(out, page, words * sizeof(word_t));
+            *bytes = words * sizeof(word_t);
+            return PACK_RAW;
+        }
+        i += length;
+    }
+    *bytes = position;
+    return PACK_DELTA;
+}
+
+int unpackPage(int kind, const unsigned char* in, uint64_t bytes,
+               word_t same, word_t* page, uint64_t words) {
+    if (kind == PACK_SAME) {
+        if (bytes != 0)
+            return 0;
+        for (uint64_t i = 0; i < words; i++)
+            page[i] = same;
+        return 1;
+    }
+    if (kind == PACK_RAW) {
+        if (bytes != words * sizeof(word_t))
+            return 0;
+        memcpy(page, in, bytes);
+        return 1;
+    }
+    if (kind != PACK_DELTA)
+        return 0;
+    uint64_t position = 0;
+    uint64_t previous = 0;
+    for (uint64_t i = 0; i < words; ) {
+        uint64_t value = 0;
+        if (!getVarint(in, bytes, &position, &value))
+            return 0;
+        uint64_t length = 1;
+        if ((value & 1) != 0) {
+            if (!getVarint(in, bytes, &position, &length)
+                || words - i < 2 || length > words - i - 2)
+                return 0;
+            length += 2;
+        }
+        const uint64_t difference = unzigzag(value >> 1);
+        for (; length > 0; length--) {
+            previous += difference;
+            page[i++] = (word_t) previous;
+        }
+    }
+    return position == bytes ? 1 : 0;
+}
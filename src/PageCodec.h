@@ -0,0 +1,28 @@
+#pragma once
+
+#include "MemoryConstants.h"
+
+// how a page is kept by the compressed swap
+#define PACK_SAME 0     // every word holds the same value, nothing stored
+#define PACK_DELTA 1    // differences of neighbouring words, run-length coded
+#define PACK_RAW 2      // the words as they are
+
+/*
+ * packs the 'words' words at 'page' into 'out', which holds at least
+ * words * sizeof(word_t) bytes.
+ * returns the kind of packing used: for PACK_SAME the value of the words
+ * is put in 'same' and nothing in 'out'; otherwise 'bytes' is set to the
+ * bytes written to 'out'. PACK_DELTA is only used when it is smaller than
+ * the page.
+ */
+int packPage(const word_t* page, uint64_t words, unsigned char* out,
+             uint64_t* bytes, word_t* same);
+
+/*
+ * fills the 'words' words at 'page' from what packPage returned.
+ * returns 1 on success, 0 if 'kind' is not a PACK_* kind or the 'bytes'
+ * bytes at 'in' do not make up exactly one page of that kind; 'page' may
+ * then be partly written
+ */
+int unpackPage(int kind, const unsigned char* in, uint64_t bytes,
+               word_t same, word_t* page, uint64_t words);
@@ -1,72 +1,112 @@
 #include "PhysicalMemory.h"
-#include <vector>
-#include <unordered_map>
-#include <cassert>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
 
 
-typedef std::vector<word_t> page_t;
-
-int evict_counter = 0;
+// the mapping is rounded up to whole system pages
+static uint64_t mappedBytes(uint64_t words) {
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    return (words * sizeof(word_t) + page - 1) / page * page;
+}
 
-std::vector<page_t> RAM;
-std::unordered_map<uint64_t, page_t> swapFile;
+word_t* allocateRam(uint64_t words) {
+    void* ram = nullptr;
+#ifdef PM_HUGEPAGES
+    const size_t bytes = ((words * sizeof(word_t) + HUGE_PAGE_SIZE - 1)
+                          / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+    // huge pages are reserved from the pool the system set aside, which
+    // costs no more memory; without the reservation a short pool would
+    // kill the process on a first touch instead of failing here
+    ram = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ram == MAP_FAILED) {
+        // reserved only, like below, but committed a huge page at a time
+        ram = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ram == MAP_FAILED) {
+            return nullptr;
+        }
+        madvise(ram, bytes, MADV_HUGEPAGE);
+    }
+#else
+    // reserved only: the kernel commits zeroed pages as they are touched
+    ram = mmap(nullptr, mappedBytes(words), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ram == MAP_FAILED) {
+        return nullptr;
+    }
+#endif
+    return static_cast<word_t*>(ram);
+}
 
-void initialize() {
-    RAM.resize(NUM_FRAMES, page_t(PAGE_SIZE));
+void freeRam(word_t* ram, uint64_t words) {
+#ifdef PM_HUGEPAGES
+    const size_t bytes = ((words * sizeof(word_t) + HUGE_PAGE_SIZE - 1)
+                          / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+    munmap(ram, bytes);
+#else
+    munmap(ram, mappedBytes(words));
+#endif
 }
 
-void PMread(uint64_t physicalAddress, word_t* value) {
+word_t* mapRam(int fd, uint64_t offset, uint64_t imageWords, uint64_t words) {
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t imageBytes = imageWords * sizeof(word_t);
+    if (offset % page != 0 || imageBytes % page != 0) {
+        return nullptr;
+    }
+    void* ram = mmap(nullptr, mappedBytes(words), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ram == MAP_FAILED) {
+        return nullptr;
+    }
+    if (mmap(ram, imageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, offset) == MAP_FAILED) {
+        munmap(ram, mappedBytes(words));
+        return nullptr;
+    }
+    return static_cast<word_t*>(ram);
+}
 
-    if (RAM.empty())
-        initialize();
+void unmapRam(word_t* ram, uint64_t words) {
+    munmap(ram, mappedBytes(words));
+}
 
-    assert(physicalAddress < RAM_SIZE);
+int readFileAt(int fd, void* buffer, uint64_t bytes, uint64_t offset) {
+    char* to = static_cast<char*>(buffer);
+    while (bytes > 0) {
+        const ssize_t done = pread(fd, to, bytes, offset);
+        if (done <= 0) {
+            return 0;
+        }
+        to += done;
+        bytes -= done;
+        offset += done;
+    }
+    return 1;
+}
 
-    *value = RAM[physicalAddress / PAGE_SIZE][physicalAddress
-             % PAGE_SIZE];
+void PMread(uint64_t physicalAddress, word_t* value) {
+    physicalMemory.read(physicalAddress, value);
 //    std::cout << "read " << *value << " from physical address " << physicalAddress << std::endl;
  }
 
 void PMwrite(uint64_t physicalAddress, word_t value) {
 //    std::cout << "write " << value << " into physical address " << physicalAddress<< std::endl;
-    if (RAM.empty())
-        initialize();
-
-    assert(physicalAddress < RAM_SIZE);
-
-    RAM[physicalAddress / PAGE_SIZE][physicalAddress
-             % PAGE_SIZE] = value;
+    physicalMemory.write(physicalAddress, value);
 }
 
 void PMevict(uint64_t frameIndex, uint64_t evictedPageIndex) {
 //    std::cout << "evict " << evictedPageIndex << " from the frame " <<frameIndex<< std::endl;
-    if (RAM.empty())
-        initialize();
-
-    assert(swapFile.find(evictedPageIndex) == swapFile.end());
-    assert(frameIndex < NUM_FRAMES);
-    assert(evictedPageIndex < NUM_PAGES);
-
-    swapFile[evictedPageIndex] = RAM[frameIndex];
-    evict_counter++;
+    physicalMemory.evict(frameIndex, evictedPageIndex);
 }
 
 void PMrestore(uint64_t frameIndex, uint64_t restoredPageIndex) {
 //    std::cout << "restore " << restoredPageIndex << " from the hard drive to the frame " << frameIndex << std::endl;
-    if (RAM.empty())
-        initialize();
-
-    assert(frameIndex < NUM_FRAMES);
-
-    // page is not in swap file, so this is essentially
-    // the first reference to this page. we can just return
-    // as it doesn't matter if the page contains garbage
-    if (swapFile.find(restoredPageIndex) == swapFile.end())
-        return;
-
-    RAM[frameIndex] = std::move(swapFile[restoredPageIndex]);
-    swapFile.erase(restoredPageIndex);
+    physicalMemory.restore(frameIndex, restoredPageIndex);
 }
 
 void printRam()
@@ -83,5 +123,5 @@ void printRam()
 
 void printEvictionCounter()
 {
-    std::cout << evict_counter << std::endl;
-}
\ No newline at end of file
+    std::cout << physicalMemory.evictionCount() << std::endl;
+}
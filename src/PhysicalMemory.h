@@ -1,6 +1,23 @@
 #pragma once
 
 #include "MemoryConstants.h"
+#include "Geometry.h"
+#include "SwapDevice.h"
+#include "FrameTable.h"
+#include "FrameArray.h"
+#include "Stats.h"
+#include "PageCodec.h"
+#include "WordScan.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef VM_THREADS
+#include <atomic>
+#endif
 
 /*
  * reads an integer from the given physical address and puts it in 'value'
@@ -30,3 +47,546 @@ void PMrestore(uint64_t frameIndex, uint64_t restoredPageIndex);
 void printRam();
 
 void printEvictionCounter();
+
+// size of a huge page used for the RAM array when PM_HUGEPAGES is defined
+#define HUGE_PAGE_SIZE (2ULL << 20)
+
+/*
+ * allocates 'words' zeroed words as one contiguous, page-aligned array.
+ * the array is only reserved: the system commits its pages as they are
+ * first touched, so the memory used follows the frames used rather than
+ * the RAM size. with PM_HUGEPAGES the array is mmapped from huge pages,
+ * falling back to transparent huge pages when none are reserved, and is
+ * committed HUGE_PAGE_SIZE bytes at a time.
+ * returns nullptr if the array cannot be mapped.
+ */
+word_t* allocateRam(uint64_t words);
+
+/*
+ * releases an array returned by allocateRam
+ */
+void freeRam(word_t* ram, uint64_t words);
+
+/*
+ * maps 'words' zeroed words like allocateRam, except that the first
+ * 'imageWords' are mapped copy-on-write from the file 'fd' at 'offset':
+ * they are read from the file as they are first touched, and writes stay
+ * in memory. returns nullptr if the offset or the size is not a multiple
+ * of the system page size, or if the mapping fails.
+ */
+word_t* mapRam(int fd, uint64_t offset, uint64_t imageWords, uint64_t words);
+
+/*
+ * releases an array returned by mapRam
+ */
+void unmapRam(word_t* ram, uint64_t words);
+
+/*
+ * reads 'bytes' bytes at 'offset' of the file 'fd' into 'buffer'.
+ * returns 1 on success, 0 if the file ends first or cannot be read
+ */
+int readFileAt(int fd, void* buffer, uint64_t bytes, uint64_t offset);
+
+// an image of a physical memory starts with these bytes, see
+// PhysicalMemory::save
+#define IMAGE_MAGIC "VMIMAGE1"
+#define IMAGE_MAGIC_SIZE 8
+// the RAM in an image starts at a multiple of this, so it can be mapped
+#define IMAGE_ALIGNMENT (64 << 10)
+
+/*
+ * The start of an image. It is followed by the reverse map, frame_info
+ * per frame, the root of every space id (-1 if detached) as int64_t, and
+ * a dirty flag byte per frame; then, from ramOffset on, by the RAM and
+ * the swapped pages, each an image_page and its packed bytes.
+ */
+typedef struct image_header {
+    char magic[IMAGE_MAGIC_SIZE];
+    uint32_t offsetWidth;           // the geometry saved
+    uint32_t physicalAddressWidth;
+    uint32_t virtualAddressWidth;
+    uint32_t wordBytes;             // sizeof(word_t)
+    uint64_t spaceIds;              // entries of the roots
+    uint64_t swapPages;             // swapped pages after the RAM
+    uint64_t ramOffset;             // multiple of IMAGE_ALIGNMENT
+    int32_t policy;                 // POLICY_* kind
+    int32_t hugePages;              // see FrameTable::setHugePages
+    vm_stats stats;                 // the counters when saved
+} image_header;
+
+// a swapped page in an image, packed by packPage
+typedef struct image_page {
+    uint64_t index;                 // swap index
+    uint32_t bytes;                 // packed bytes that follow
+    int32_t kind;                   // PACK_* kind
+    word_t same;                    // the value of a PACK_SAME page
+} image_page;
+
+/*
+ * The RAM, swap and frames of one geometry, shared by every AddressSpace
+ * built on it. The PM* functions above work on the instance of
+ * DefaultGeometry, physicalMemory.
+ *
+ * One more frame of zeros sits past the end of the RAM, at frame index
+ * G::numFrames: the zero frame, which reads of never-written pages are
+ * mapped to. It is never written and never handed out by FrameTable.
+ */
+template <class G>
+class PhysicalMemory
+{
+public:
+    PhysicalMemory() : ram(allocateRam(G::ramSize + G::pageSize)),
+                       ramMapped(false), swap(G::pageSize),
+                       dirty(G::numFrames), frames(*this) {}
+    ~PhysicalMemory() { releaseRam(); }
+    PhysicalMemory(const PhysicalMemory&) = delete;
+    PhysicalMemory& operator=(const PhysicalMemory&) = delete;
+
+    /*
+     * returns 1 if the RAM could be allocated, 0 otherwise: nothing may
+     * then be read or written, and address spaces fail to initialize on
+     * this memory
+     */
+    int allocated() const { return ram != nullptr ? 1 : 0; }
+
+    void read(uint64_t physicalAddress, word_t* value) const {
+        assert(physicalAddress < G::ramSize + G::pageSize);
+        counters.recordRead();
+        *value = ram[physicalAddress];
+    }
+
+    void write(uint64_t physicalAddress, word_t value) {
+        assert(physicalAddress < G::ramSize);
+        counters.recordWrite();
+        markDirty(physicalAddress / G::pageSize);
+        ram[physicalAddress] = value;
+    }
+
+    /*
+     * bit i of the result is set if word i of the 'count' (at most 64)
+     * words from the given physical address on is not 0, see nonZeroMask.
+     * counts as 'count' reads
+     */
+    uint64_t nonZeroWords(uint64_t physicalAddress, uint64_t count) const {
+        assert(physicalAddress + count <= G::ramSize + G::pageSize);
+        counters.recordReads(count);
+        return nonZeroMask(ram + physicalAddress, count);
+    }
+
+    /*
+     * zeroes every word of a frame, a new or cleared table. counts as
+     * G::pageSize writes
+     */
+    void clearFrame(uint64_t frameIndex) {
+        assert(frameIndex < G::numFrames);
+        counters.recordWrites(G::pageSize);
+        markDirty(frameIndex);
+        memset(ram + frameIndex * G::pageSize, 0,
+               G::pageSize * sizeof(word_t));
+    }
+
+    /*
+     * pages of address spaces other than the first are swapped under
+     * indexes past NUM_PAGES, see FrameTable::swapKey.
+     * a page that was not written since it was restored still has its copy
+     * in swap, its frame is just dropped.
+     * returns 1 on success, 0 if the swap device could not store the page:
+     * it must then stay in its frame
+     */
+    int evict(uint64_t frameIndex, uint64_t evictedPageIndex) {
+        assert(frameIndex < G::numFrames);
+
+        const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        if (isDirty(frameIndex) || !swap.contains(evictedPageIndex)) {
+            const int stored = swap.store(evictedPageIndex,
+                                          ram + frameIndex * G::pageSize);
+            counters.recordSwapUsage(swap.pageCount(), swap.footprint());
+            if (!stored) {
+                return 0;
+            }
+        } else {
+            counters.recordCleanEviction();
+        }
+        counters.recordEviction();
+        counters.recordEvictTime(nanosecondsSince(start));
+        return 1;
+    }
+
+    /*
+     * returns 1 on success, 0 if the swap device could not read the page
+     */
+    int restore(uint64_t frameIndex, uint64_t restoredPageIndex) {
+        assert(frameIndex < G::numFrames);
+
+        // if the page is not in swap file, this is the first write to
+        // the page: it gets a copy of the zero frame
+        const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        word_t* const frame = ram + frameIndex * G::pageSize;
+        const int loaded = swap.load(restoredPageIndex, frame);
+        if (loaded < 0) {
+            return 0;
+        }
+        const bool restored = loaded != 0;
+        if (!restored) {
+            memcpy(frame, ram + G::ramSize, G::pageSize * sizeof(word_t));
+        }
+        counters.recordFault(restored);
+        setDirty(frameIndex, false);
+        counters.recordRestoreTime(nanosecondsSince(start));
+        return 1;
+    }
+
+    /*
+     * gives a frame a copy of the page in sourceFrame, the zero frame
+     * included, or if sourceFrame is 0 of the page swapped under
+     * sourcePageIndex: the first write of an address space to a page it
+     * shares with a fork, see FrameTable::fork. The copy has no copy in
+     * swap yet, so it is dirty.
+     * returns 1 on success, 0 if the swap device could not read the page
+     */
+    int copyPage(uint64_t frameIndex, uint64_t sourceFrame,
+                 uint64_t sourcePageIndex) {
+        assert(frameIndex < G::numFrames && sourceFrame <= G::numFrames);
+
+        const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        word_t* const frame = ram + frameIndex * G::pageSize;
+        if (sourceFrame != 0) {
+            memcpy(frame, ram + sourceFrame * G::pageSize,
+                   G::pageSize * sizeof(word_t));
+        } else {
+            const int loaded = swap.load(sourcePageIndex, frame);
+            if (loaded < 0) {
+                return 0;
+            }
+            if (loaded == 0) {
+                memcpy(frame, ram + G::ramSize, G::pageSize * sizeof(word_t));
+            }
+        }
+        counters.recordCopyFault();
+        setDirty(frameIndex, true);
+        counters.recordRestoreTime(nanosecondsSince(start));
+        return 1;
+    }
+
+    /*
+     * selects the swap backend, dropping every swapped page, see
+     * SwapDevice::initialize
+     */
+    int initializeSwap(int backend, const char* path) {
+        const int result = swap.initialize(backend, path);
+        counters.recordSwapUsage(swap.pageCount(), swap.footprint());
+        return result;
+    }
+
+    /*
+     * returns true if the page has a copy in swap
+     */
+    bool swapped(uint64_t pageIndex) {
+        return swap.contains(pageIndex) != 0;
+    }
+
+    /*
+     * drops the swapped pages with indexes in [firstIndex, lastIndex]
+     */
+    void discardSwap(uint64_t firstIndex, uint64_t lastIndex) {
+        swap.discard(firstIndex, lastIndex);
+        counters.recordSwapUsage(swap.pageCount(), swap.footprint());
+    }
+
+    /*
+     * writes an image of the memory to 'path': the counters, the frames
+     * and roots of the address spaces, the dirty flags, the RAM and every
+     * swapped page, packed. The memory must be quiescent.
+     * returns 1 on success, 0 if the RAM was not allocated, the file
+     * could not be written, the policy is not one of the POLICY_* kinds
+     * or spaces share the pages of a fork, see FrameTable::fork
+     */
+    int save(const char* path) {
+        if (ram == nullptr || frames.policyOf() < 0 || frames.forked()) {
+            return 0;
+        }
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            return 0;
+        }
+        frames.pauseReclaimer();
+        image_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, IMAGE_MAGIC, IMAGE_MAGIC_SIZE);
+        header.offsetWidth = G::offsetWidth;
+        header.physicalAddressWidth = G::physicalAddressWidth;
+        header.virtualAddressWidth = G::virtualAddressWidth;
+        header.wordBytes = sizeof(word_t);
+        header.spaceIds = frames.spaceIds();
+        const std::vector<uint64_t> indexes = swap.pageIndexes();
+        header.swapPages = indexes.size();
+        header.policy = frames.policyOf();
+        header.hugePages = frames.hugePages();
+        counters.snapshot(&header.stats);
+        std::vector<int64_t> roots(header.spaceIds);
+        for (uint64_t id = 0; id < header.spaceIds; ++id) {
+            roots[id] = frames.isAttached(id) ? frames.rootOf(id) : -1;
+        }
+        std::vector<uint8_t> flags(G::numFrames);
+        for (uint64_t i = 0; i < G::numFrames; ++i) {
+            flags[i] = isDirty(i);
+        }
+        header.ramOffset = imageRamOffset(header.spaceIds);
+
+        bool written =
+            fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(frames.frameInfo().data(), sizeof(frame_info),
+                      G::numFrames, file) == G::numFrames
+            && fwrite(roots.data(), sizeof(int64_t), roots.size(), file)
+               == roots.size()
+            && fwrite(flags.data(), 1, flags.size(), file) == flags.size()
+            && fseek(file, header.ramOffset, SEEK_SET) == 0
+            && fwrite(ram, sizeof(word_t), G::ramSize, file) == G::ramSize;
+        std::vector<word_t> page(G::pageSize);
+        std::vector<unsigned char> packed(G::pageSize * sizeof(word_t));
+        for (size_t i = 0; written && i < indexes.size(); ++i) {
+            image_page record;
+            memset(&record, 0, sizeof(record));
+            record.index = indexes[i];
+            uint64_t bytes = 0;
+            if (swap.load(indexes[i], page.data()) != 1) {
+                written = false;
+                break;
+            }
+            record.kind = packPage(page.data(), G::pageSize, packed.data(),
+                                   &bytes, &record.same);
+            record.bytes = bytes;
+            written = fwrite(&record, sizeof(record), 1, file) == 1
+                      && fwrite(packed.data(), 1, bytes, file) == bytes;
+        }
+        frames.resumeReclaimer();
+        written = fclose(file) == 0 && written;
+        return written ? 1 : 0;
+    }
+
+    /*
+     * takes over the state saved to 'path' by save, with the same address
+     * spaces (by id) attached as were then. The RAM is mapped from the
+     * file, so frames are read from it as they are first touched; the
+     * swapped pages go to the current swap backend, replacing those in
+     * it. The memory must be quiescent, and the replacement policy starts
+     * over without history.
+     * returns 1 on success, 0 if the RAM was not allocated, the file
+     * cannot be read or holds no image of this geometry and these spaces,
+     * any of its frames, roots or swapped pages is out of range or does
+     * not unpack, or if spaces share the pages of a fork; the memory is
+     * then left as it was. 0 is returned as
+     * well if the swap device fails to store the swapped pages of the
+     * image, which the memory then holds without them
+     */
+    int load(const char* path) {
+        if (ram == nullptr || frames.forked()) {
+            return 0;
+        }
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return 0;
+        }
+        image_header header;
+        std::vector<frame_info> info(G::numFrames);
+        std::vector<int64_t> roots;
+        std::vector<uint8_t> flags(G::numFrames);
+        bool valid = readFileAt(fd, &header, sizeof(header), 0)
+                     && memcmp(header.magic, IMAGE_MAGIC, IMAGE_MAGIC_SIZE)
+                        == 0
+                     && header.offsetWidth == G::offsetWidth
+                     && header.physicalAddressWidth
+                        == G::physicalAddressWidth
+                     && header.virtualAddressWidth == G::virtualAddressWidth
+                     && header.wordBytes == sizeof(word_t)
+                     && header.spaceIds == frames.spaceIds()
+                     && header.policy >= 0 && header.policy < POLICY_COUNT
+                     && header.ramOffset == imageRamOffset(header.spaceIds);
+        if (valid) {
+            const uint64_t rootsOffset = sizeof(header)
+                                         + G::numFrames * sizeof(frame_info);
+            roots.resize(header.spaceIds);
+            valid = readFileAt(fd, info.data(),
+                               G::numFrames * sizeof(frame_info),
+                               sizeof(header))
+                    && readFileAt(fd, roots.data(),
+                                  roots.size() * sizeof(int64_t), rootsOffset)
+                    && readFileAt(fd, flags.data(), flags.size(), rootsOffset
+                                  + roots.size() * sizeof(int64_t));
+        }
+        for (uint64_t id = 0; valid && id < header.spaceIds; ++id) {
+            valid = (roots[id] >= 0) == frames.isAttached(id);
+        }
+        valid = valid && frames.validImage(info.data(), roots.data());
+        // the swapped pages are read and unpacked first, so a short or
+        // damaged file changes nothing
+        std::vector<image_page> records;
+        std::vector<unsigned char> packed;
+        std::vector<word_t> page(G::pageSize);
+        uint64_t offset = header.ramOffset + G::ramSize * sizeof(word_t);
+        for (uint64_t i = 0; valid && i < header.swapPages; ++i) {
+            image_page record;
+            valid = readFileAt(fd, &record, sizeof(record), offset)
+                    && record.bytes <= G::pageSize * sizeof(word_t)
+                    && record.index / G::numPages < header.spaceIds;
+            offset += sizeof(record);
+            if (valid) {
+                records.push_back(record);
+                packed.resize(packed.size() + record.bytes);
+                unsigned char* bytes = packed.data() + packed.size()
+                                       - record.bytes;
+                valid = readFileAt(fd, bytes, record.bytes, offset)
+                        && unpackPage(record.kind, bytes, record.bytes,
+                                      record.same, page.data(), G::pageSize);
+                offset += record.bytes;
+            }
+        }
+        word_t* mapped = valid ? mapRam(fd, header.ramOffset, G::ramSize,
+                                        G::ramSize + G::pageSize)
+                               : nullptr;
+        if (valid && mapped == nullptr) {
+            // too small to map: copied instead
+            std::vector<word_t> words(G::ramSize);
+            valid = readFileAt(fd, words.data(), G::ramSize * sizeof(word_t),
+                               header.ramOffset);
+            if (valid) {
+                memcpy(ram, words.data(), G::ramSize * sizeof(word_t));
+            }
+        }
+        close(fd);
+        if (!valid) {
+            return 0;
+        }
+
+        frames.pauseReclaimer();
+        if (mapped != nullptr) {
+            releaseRam();
+            ram = mapped;
+            ramMapped = true;
+        }
+        // only the flags that are set are written, the others stay
+        // uncommitted
+        dirty.clear();
+        for (uint64_t i = 0; i < G::numFrames; ++i) {
+            if (flags[i] != 0) {
+                setDirty(i, true);
+            }
+        }
+        bool stored = true;
+        swap.discard(0, ~0ULL);
+        const unsigned char* bytes = packed.data();
+        for (size_t i = 0; i < records.size(); ++i) {
+            const int unpacked = unpackPage(records[i].kind, bytes,
+                                            records[i].bytes, records[i].same,
+                                            page.data(), G::pageSize);
+            assert(unpacked == 1);
+            (void) unpacked;
+            stored = swap.store(records[i].index, page.data()) && stored;
+            bytes += records[i].bytes;
+        }
+        counters.restore(header.stats);
+        counters.recordSwapUsage(swap.pageCount(), swap.footprint());
+        std::vector<word_t> savedRoots(roots.begin(), roots.end());
+        frames.loadImage(info.data(), savedRoots.data(), header.policy,
+                         header.hugePages != 0);
+        frames.resumeReclaimer();
+        return stored ? 1 : 0;
+    }
+
+    /*
+     * direct access to the words from the given physical address on, for
+     * block copies that stay within one frame. writes through it must
+     * mark the frame dirty and stay out of the zero frame
+     */
+    word_t* data(uint64_t physicalAddress) {
+        assert(physicalAddress < G::ramSize + G::pageSize);
+        return ram + physicalAddress;
+    }
+
+    /*
+     * the frame was written since its page was restored, so evicting it
+     * has to store the page again
+     */
+    void markDirty(uint64_t frameIndex) {
+        assert(frameIndex < G::numFrames);
+        // skip the store when set, so reads of the flag stay shared
+        if (!isDirty(frameIndex)) {
+            setDirty(frameIndex, true);
+        }
+    }
+
+    bool isDirty(uint64_t frameIndex) const {
+#ifdef VM_THREADS
+        return dirty[frameIndex].load(std::memory_order_relaxed) != 0;
+#else
+        return dirty[frameIndex] != 0;
+#endif
+    }
+
+    SwapDevice& swapDevice() { return swap; }
+
+    FrameTable<G>& frameTable() { return frames; }
+
+    uint64_t evictionCount() const { return counters.evictionCount(); }
+
+    /*
+     * faults, evictions, frame searches and word accesses of every address
+     * space on this memory, see vm_stats
+     */
+    StatsCounters& stats() { return counters; }
+
+private:
+#ifdef VM_THREADS
+    typedef std::atomic<uint8_t> dirty_t;
+#else
+    typedef uint8_t dirty_t;
+#endif
+
+    // where the RAM starts in an image with this many space ids
+    static uint64_t imageRamOffset(uint64_t spaceIds) {
+        const uint64_t bytes = sizeof(image_header)
+                               + G::numFrames * sizeof(frame_info)
+                               + spaceIds * sizeof(int64_t) + G::numFrames;
+        return (bytes + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT
+               * IMAGE_ALIGNMENT;
+    }
+
+    void releaseRam() {
+        if (ram == nullptr) {
+            return;
+        }
+        if (ramMapped) {
+            unmapRam(ram, G::ramSize + G::pageSize);
+        } else {
+            freeRam(ram, G::ramSize + G::pageSize);
+        }
+    }
+
+    static uint64_t nanosecondsSince(
+            std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    void setDirty(uint64_t frameIndex, bool value) {
+#ifdef VM_THREADS
+        dirty[frameIndex].store(value, std::memory_order_relaxed);
+#else
+        dirty[frameIndex] = value;
+#endif
+    }
+
+    // from allocateRam, or from mapRam once an image was loaded
+    word_t* ram;
+    bool ramMapped;
+    SwapDevice swap;
+    // one flag per frame, see markDirty
+    FrameArray<dirty_t> dirty;
+    StatsCounters counters;
+    FrameTable<G> frames;
+};
+
+extern PhysicalMemory<DefaultGeometry> physicalMemory;
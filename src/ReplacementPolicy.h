@@ -0,0 +1,846 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#include "Geometry.h"
+#include "FrameArray.h"
+#include <map>
+#include <list>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// role of a frame in the reverse map
+#define FRAME_FREE 0
+#define FRAME_TABLE 1
+#define FRAME_PAGE 2
+#define FRAME_HUGE 3     // a frame of a huge page past its first
+
+// page replacement policies, see ReplacementPolicy::create
+#define POLICY_CYCLIC 0     // largest cyclic distance to the faulting page
+#define POLICY_WEIGHTED 1   // heaviest path, by WEIGHT_EVEN and WEIGHT_ODD
+#define POLICY_LRU 2        // least recently used
+#define POLICY_CLOCK 3      // second chance
+#define POLICY_LFU 4        // least frequently used
+#define POLICY_ARC 5        // adaptive replacement cache
+#define POLICY_COUNT 6
+
+/**
+ * Reverse map entry: what a frame holds and where it is linked from.
+ * Kept up to date by every write that links or unlinks a frame.
+ */
+typedef struct frame_info{
+  int role;                  // One of the FRAME_* roles above
+  int layer;                 // Table layer, TABLES_DEPTH for a page
+  word_t parentTable;        // Table that points to this frame
+  word_t offset;             // Offset in parent table
+  uint64_t page;             // Page held, or first page under a table
+  int liveEntries;           // Non-zero entries of a FRAME_TABLE frame
+  int space;                 // Address space the frame belongs to
+  uint64_t run;              // Frames of the huge page it starts, else 0
+}frame_info;
+
+/**
+ * Chooses which resident page a FrameTable evicts when it is out of free
+ * frames and empty tables. The frame table reports every page that comes
+ * into or leaves RAM; policies that ask for it also see every access to
+ * a resident page. Pages are identified by their frame, frames[] tells
+ * what a frame holds. A huge page is seen as the page in its first frame
+ * only; choosing it evicts the whole run. State kept per frame is in
+ * FrameArrays, so it is committed only for the frames in use.
+ */
+template <class G>
+class ReplacementPolicy
+{
+public:
+  explicit ReplacementPolicy (const FrameArray<frame_info> &frameInfo)
+      : frames (frameInfo)
+  {
+  }
+
+  virtual ~ReplacementPolicy ()
+  {
+  }
+
+  // the stock policy of the given POLICY_* kind, nullptr if unknown
+  static ReplacementPolicy *create (int kind,
+                                    const FrameArray<frame_info> &frames);
+
+  // frame now holds a page, frames[frame] is already filled in
+  virtual void pageIn (word_t frame) = 0;
+
+  // the page in frame leaves RAM, frames[frame] still describes it
+  virtual void pageOut (word_t frame) = 0;
+
+  // true if touch has to be called on every access
+  virtual bool tracksAccess () const
+  {
+    return false;
+  }
+
+  // the page in frame was read or written
+  virtual void touch (word_t frame)
+  {
+    (void) frame;
+  }
+
+  /**
+   * The frame of the page to evict for a fault on 'page' of 'space'.
+   * Frames listed in 'busy' must be passed over.
+   * @return 0 if every resident page is busy
+   */
+  virtual word_t victim (int space, uint64_t page,
+                         const std::vector<word_t> &busy) = 0;
+
+protected:
+  static bool isBusy (word_t frame, const std::vector<word_t> &busy)
+  {
+    return std::find (busy.begin (), busy.end (), frame) != busy.end ();
+  }
+
+  const FrameArray<frame_info> &frames;
+};
+
+/**
+ * Evicts the page with maximum cyclic distance to the faulting page.
+ * Resident pages are indexed by page number, then space, so only the two
+ * neighbours of the point opposite the faulting page are candidates.
+ */
+template <class G>
+class CyclicPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit CyclicPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo)
+  {
+  }
+
+  // Calculate minimum cyclic distance between two pages
+  static uint64_t minCyclic (const uint64_t page_swapped_in, const uint64_t p)
+  {
+    const uint64_t distance = page_swapped_in > p ? page_swapped_in - p
+                                                  : p - page_swapped_in;
+    const uint64_t cyclic_distance = G::numPages - distance;
+    return cyclic_distance < distance ? cyclic_distance : distance;
+  }
+
+  void pageIn (word_t frame)
+  {
+    residentPages[key (frame)] = frame;
+  }
+
+  void pageOut (word_t frame)
+  {
+    residentPages.erase (key (frame));
+  }
+
+  /**
+   * The cyclic distance to page_swapped_in is largest for the pages closest
+   * to the opposite point of the cycle, so only its two resident neighbours
+   * are candidates. They are offered in page order, so ties go to the lower
+   * page number, which is the page dfs would meet first.
+   * The same page number resident in several spaces sits in space order on
+   * the cycle, so the neighbour is the one nearest the opposite point.
+   * A busy page is skipped for its next neighbour on the same side; if
+   * every resident page is busy 0 is returned.
+   */
+  word_t victim (int, uint64_t page_swapped_in,
+                 const std::vector<word_t> &busy)
+  {
+    if (residentPages.empty ())
+    {
+      return 0;
+    }
+    const uint64_t opposite = (page_swapped_in + G::numPages / 2)
+                              % G::numPages;
+    resident_iter after = residentPages.lower_bound (resident_key (opposite,
+                                                                   0));
+    resident_iter before = after;
+    if (after == residentPages.end ())
+    {
+      after = residentPages.begin ();
+    }
+    if (before == residentPages.begin ())
+    {
+      before = residentPages.end ();
+    }
+    --before;
+    after = skipBusy (after, true, busy);
+    before = skipBusy (before, false, busy);
+    if (this->isBusy (after->second, busy))
+    {
+      return 0;
+    }
+    uint64_t maxDistance = 0;
+    word_t cyclicFrame = 0;
+    if (after->first < before->first)
+    {
+      considerVictim (after, page_swapped_in, &maxDistance, &cyclicFrame);
+      considerVictim (before, page_swapped_in, &maxDistance, &cyclicFrame);
+    }
+    else
+    {
+      considerVictim (before, page_swapped_in, &maxDistance, &cyclicFrame);
+      considerVictim (after, page_swapped_in, &maxDistance, &cyclicFrame);
+    }
+    return cyclicFrame;
+  }
+
+private:
+  // resident pages are ordered by page number, then by space
+  typedef std::pair<uint64_t, int> resident_key;
+  typedef typename std::map<resident_key, word_t>::const_iterator
+      resident_iter;
+
+  resident_key key (word_t frame) const
+  {
+    return resident_key (this->frames[frame].page,
+                         this->frames[frame].space);
+  }
+
+  // Step over busy candidates in the given direction of the cycle.
+  // If every resident page is busy a busy page is returned.
+  resident_iter skipBusy (resident_iter it, bool forward,
+                          const std::vector<word_t> &busy) const
+  {
+    for (uint64_t i = 0; i < busy.size ()
+                         && this->isBusy (it->second, busy); ++i)
+    {
+      if (forward)
+      {
+        if (++it == residentPages.end ())
+        {
+          it = residentPages.begin ();
+        }
+      }
+      else
+      {
+        if (it == residentPages.begin ())
+        {
+          it = residentPages.end ();
+        }
+        --it;
+      }
+    }
+    return it;
+  }
+
+  // Offer a resident page as eviction candidate, keeps the first maximum.
+  // The first candidate is always taken: another space may hold the
+  // faulting page number itself, at distance 0.
+  static void considerVictim (resident_iter candidate,
+                              uint64_t page_swapped_in,
+                              uint64_t *maxDistance, word_t *cyclicFrame)
+  {
+    uint64_t x = minCyclic (page_swapped_in, candidate->first.first);
+    if (x > *maxDistance || *cyclicFrame == 0)
+    {
+      *maxDistance = x;
+      *cyclicFrame = candidate->second;
+    }
+  }
+
+  std::map<resident_key, word_t> residentPages;
+};
+
+/**
+ * Evicts the page with the heaviest path. Every frame on the path from the
+ * root table to the page, and the page number itself, weighs WEIGHT_EVEN
+ * if it is even and WEIGHT_ODD if it is odd. Ties go to the lower page
+ * number. A resident page's path cannot change, so its weight is computed
+ * once when it comes in.
+ */
+template <class G>
+class WeightedPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit WeightedPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo), keys (G::numFrames)
+  {
+  }
+
+  static int64_t weight (uint64_t number)
+  {
+    return number % 2 == 0 ? WEIGHT_EVEN : WEIGHT_ODD;
+  }
+
+  void pageIn (word_t frame)
+  {
+    int64_t total = weight (this->frames[frame].page);
+    for (word_t f = frame;; f = this->frames[f].parentTable)
+    {
+      total += weight (f);
+      if (this->frames[f].layer == 0)
+      {
+        break;
+      }
+    }
+    keys[frame] = weighted_key (-total, this->frames[frame].page,
+                                this->frames[frame].space);
+    pages[keys[frame]] = frame;
+  }
+
+  void pageOut (word_t frame)
+  {
+    pages.erase (keys[frame]);
+  }
+
+  word_t victim (int, uint64_t, const std::vector<word_t> &busy)
+  {
+    for (weighted_iter it = pages.begin (); it != pages.end (); ++it)
+    {
+      if (!this->isBusy (it->second, busy))
+      {
+        return it->second;
+      }
+    }
+    return 0;
+  }
+
+private:
+  // heaviest first, then by page number and space
+  typedef std::tuple<int64_t, uint64_t, int> weighted_key;
+  typedef typename std::map<weighted_key, word_t>::const_iterator
+      weighted_iter;
+
+  std::map<weighted_key, word_t> pages;
+  FrameArray<weighted_key> keys;
+};
+
+/**
+ * Keeps the resident pages in a list by frame, most recently used first,
+ * and evicts from the tail. Links are indexed by frame, so an access
+ * moves its page with a few stores.
+ */
+template <class G>
+class LruPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit LruPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo), next (G::numFrames + 1),
+        prev (G::numFrames + 1), linked (G::numFrames)
+  {
+    next[head] = head;
+    prev[head] = head;
+  }
+
+  void pageIn (word_t frame)
+  {
+    pushFront (frame);
+  }
+
+  void pageOut (word_t frame)
+  {
+    unlink (frame);
+  }
+
+  bool tracksAccess () const
+  {
+    return true;
+  }
+
+  void touch (word_t frame)
+  {
+    if (linked[frame] && next[head] != (uint64_t) frame)
+    {
+      unlink (frame);
+      pushFront (frame);
+    }
+  }
+
+  word_t victim (int, uint64_t, const std::vector<word_t> &busy)
+  {
+    for (uint64_t f = prev[head]; f != head; f = prev[f])
+    {
+      if (!this->isBusy (f, busy))
+      {
+        return f;
+      }
+    }
+    return 0;
+  }
+
+private:
+  // the list head, one past the last frame
+  static const uint64_t head = G::numFrames;
+
+  void pushFront (word_t frame)
+  {
+    next[frame] = next[head];
+    prev[frame] = head;
+    prev[next[head]] = frame;
+    next[head] = frame;
+    linked[frame] = true;
+  }
+
+  void unlink (word_t frame)
+  {
+    next[prev[frame]] = next[frame];
+    prev[next[frame]] = prev[frame];
+    linked[frame] = false;
+  }
+
+  FrameArray<uint64_t> next;
+  FrameArray<uint64_t> prev;
+  FrameArray<uint8_t> linked;
+};
+
+/**
+ * Second chance: a hand sweeps the frames, clearing the referenced bit of
+ * every resident page it passes, and evicts the first page whose bit is
+ * already clear.
+ */
+template <class G>
+class ClockPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit ClockPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo), resident (G::numFrames),
+        referenced (G::numFrames), hand (0)
+  {
+  }
+
+  void pageIn (word_t frame)
+  {
+    resident[frame] = 1;
+    referenced[frame] = 0;
+  }
+
+  void pageOut (word_t frame)
+  {
+    resident[frame] = 0;
+  }
+
+  bool tracksAccess () const
+  {
+    return true;
+  }
+
+  void touch (word_t frame)
+  {
+    referenced[frame] = 1;
+  }
+
+  word_t victim (int, uint64_t, const std::vector<word_t> &busy)
+  {
+    // two turns clear every bit, a third only meets busy pages
+    for (uint64_t step = 0; step < 2 * G::numFrames; ++step)
+    {
+      hand = (hand + 1) % G::numFrames;
+      if (!resident[hand] || this->isBusy (hand, busy))
+      {
+        continue;
+      }
+      if (referenced[hand])
+      {
+        referenced[hand] = 0;
+        continue;
+      }
+      return hand;
+    }
+    return 0;
+  }
+
+private:
+  FrameArray<uint8_t> resident;
+  FrameArray<uint8_t> referenced;
+  uint64_t hand;
+};
+
+/**
+ * Evicts the page accessed the fewest times since it came in, among equals
+ * the one that reached that count first. Resident pages sit in buckets by
+ * count, oldest first, and the buckets in a list by increasing count, so
+ * an access moves its page to the next bucket with a few stores and the
+ * victim is the first page of the first bucket. There are never more
+ * buckets than resident pages, so they are indexed like the frames.
+ */
+template <class G>
+class LfuPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit LfuPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo), next (G::numFrames),
+        prev (G::numFrames), bucket (G::numFrames),
+        count (G::numFrames + 1), first (G::numFrames + 1),
+        last (G::numFrames + 1), nextBucket (G::numFrames + 1),
+        prevBucket (G::numFrames + 1), spare (0), unused (1)
+  {
+  }
+
+  void pageIn (word_t frame)
+  {
+    uint64_t into = nextBucket[head];
+    if (into == head || count[into] != 0)
+    {
+      into = newBucket (head, 0);
+    }
+    append (into, frame);
+  }
+
+  void pageOut (word_t frame)
+  {
+    remove (frame);
+  }
+
+  bool tracksAccess () const
+  {
+    return true;
+  }
+
+  void touch (word_t frame)
+  {
+    const uint64_t from = bucket[frame];
+    if (from == 0)
+    {
+      return;
+    }
+    uint64_t into = nextBucket[from];
+    const bool nextCount = into != head && count[into] == count[from] + 1;
+    if (first[from] == last[from] && !nextCount)
+    {
+      // alone in its bucket, the bucket moves up instead
+      count[from]++;
+      return;
+    }
+    if (!nextCount)
+    {
+      into = newBucket (from, count[from] + 1);
+    }
+    remove (frame);
+    append (into, frame);
+  }
+
+  word_t victim (int, uint64_t, const std::vector<word_t> &busy)
+  {
+    for (uint64_t b = nextBucket[head]; b != head; b = nextBucket[b])
+    {
+      for (uint64_t f = first[b]; f != 0; f = next[f])
+      {
+        if (!this->isBusy (f, busy))
+        {
+          return f;
+        }
+      }
+    }
+    return 0;
+  }
+
+private:
+  // the list head of the buckets; frame 0 never holds a page, so 0 also
+  // ends the list of a bucket
+  static const uint64_t head = 0;
+
+  // a cleared bucket for pages used 'uses' times, linked after 'after'
+  uint64_t newBucket (uint64_t after, uint64_t uses)
+  {
+    uint64_t b = spare;
+    if (b != 0)
+    {
+      spare = nextBucket[b];
+    }
+    else
+    {
+      b = unused++;
+    }
+    count[b] = uses;
+    first[b] = 0;
+    last[b] = 0;
+    nextBucket[b] = nextBucket[after];
+    prevBucket[b] = after;
+    prevBucket[nextBucket[after]] = b;
+    nextBucket[after] = b;
+    return b;
+  }
+
+  void append (uint64_t into, word_t frame)
+  {
+    bucket[frame] = into;
+    next[frame] = 0;
+    prev[frame] = last[into];
+    if (last[into] != 0)
+    {
+      next[last[into]] = frame;
+    }
+    else
+    {
+      first[into] = frame;
+    }
+    last[into] = frame;
+  }
+
+  // unlink a page from its bucket, and the bucket if it is left empty
+  void remove (word_t frame)
+  {
+    const uint64_t from = bucket[frame];
+    if (prev[frame] != 0)
+    {
+      next[prev[frame]] = next[frame];
+    }
+    else
+    {
+      first[from] = next[frame];
+    }
+    if (next[frame] != 0)
+    {
+      prev[next[frame]] = prev[frame];
+    }
+    else
+    {
+      last[from] = prev[frame];
+    }
+    bucket[frame] = 0;
+    if (first[from] == 0)
+    {
+      nextBucket[prevBucket[from]] = nextBucket[from];
+      prevBucket[nextBucket[from]] = prevBucket[from];
+      nextBucket[from] = spare;
+      spare = from;
+    }
+  }
+
+  // links of the pages of a bucket, and the bucket of a page, 0 if none
+  FrameArray<uint64_t> next;
+  FrameArray<uint64_t> prev;
+  FrameArray<uint64_t> bucket;
+  // buckets: the count of their pages, their first and last page and
+  // their neighbours by count
+  FrameArray<uint64_t> count;
+  FrameArray<uint64_t> first;
+  FrameArray<uint64_t> last;
+  FrameArray<uint64_t> nextBucket;
+  FrameArray<uint64_t> prevBucket;
+  // the first bucket given back, and the first one never used
+  uint64_t spare;
+  uint64_t unused;
+};
+
+/**
+ * Adaptive replacement cache (Megiddo and Modha). Resident pages seen once
+ * are in T1 and pages seen again in T2, both most recent first; B1 and B2
+ * remember pages recently evicted from each. A fault on a page in B1 grows
+ * the target size p of T1, one in B2 shrinks it, and the victim comes
+ * from T1 while T1 is larger than p. The fault moves p in victim, before
+ * the victim is chosen, or in pageIn if it took a free frame. The lists
+ * are sized for the number of frames; the access that faults a page in is
+ * not counted as a hit.
+ * T1 and T2 are linked by frame like the list of LruPolicy, so a hit
+ * moves its page with a few stores.
+ */
+template <class G>
+class ArcPolicy : public ReplacementPolicy<G>
+{
+public:
+  explicit ArcPolicy (const FrameArray<frame_info> &frameInfo)
+      : ReplacementPolicy<G> (frameInfo), next (G::numFrames + 2),
+        prev (G::numFrames + 2), listed (G::numFrames),
+        fresh (G::numFrames), target (0)
+  {
+    for (int list = T1; list <= T2; ++list)
+    {
+      next[head (list)] = head (list);
+      prev[head (list)] = head (list);
+      sizes[list] = 0;
+    }
+  }
+
+  void pageIn (word_t frame)
+  {
+    const page_key page = key (frame);
+    int list = T1;
+    if (adapted.erase (page) != 0 || adapt (page) >= 0)
+    {
+      list = T2;
+    }
+    insert (list, frame);
+    fresh[frame] = true;
+  }
+
+  void pageOut (word_t frame)
+  {
+    const int list = listed[frame] - 1;
+    erase (frame);
+    remember (list == T1 ? B1 : B2, key (frame));
+  }
+
+  bool tracksAccess () const
+  {
+    return true;
+  }
+
+  void touch (word_t frame)
+  {
+    if (fresh[frame])
+    {
+      fresh[frame] = false;
+      return;
+    }
+    if (listed[frame] != 0)
+    {
+      erase (frame);
+      insert (T2, frame);
+    }
+  }
+
+  word_t victim (int space, uint64_t page, const std::vector<word_t> &busy)
+  {
+    const page_key faulting (page, space);
+    const int ghost = adapt (faulting);
+    if (ghost >= 0)
+    {
+      adapted[faulting] = ghost;
+    }
+    typename std::map<page_key, int>::const_iterator hit
+        = adapted.find (faulting);
+    const bool inB2 = hit != adapted.end () && hit->second == B2;
+    const uint64_t size1 = sizes[T1];
+    const bool fromT1 = size1 > 0
+                        && (size1 > target || (inB2 && size1 == target));
+    word_t frame = oldest (fromT1 ? T1 : T2, busy);
+    if (frame == 0)
+    {
+      frame = oldest (fromT1 ? T2 : T1, busy);
+    }
+    return frame;
+  }
+
+private:
+  // resident lists and ghost lists
+  enum { T1 = 0, T2 = 1, B1 = 0, B2 = 1 };
+  typedef std::pair<uint64_t, int> page_key;
+  typedef std::list<page_key>::iterator ghost_iter;
+
+  // the list heads of T1 and T2, past the last frame
+  static uint64_t head (int list)
+  {
+    return G::numFrames + list;
+  }
+
+  page_key key (word_t frame) const
+  {
+    return page_key (this->frames[frame].page, this->frames[frame].space);
+  }
+
+  void insert (int list, word_t frame)
+  {
+    const uint64_t first = head (list);
+    next[frame] = next[first];
+    prev[frame] = first;
+    prev[next[first]] = frame;
+    next[first] = frame;
+    listed[frame] = list + 1;
+    sizes[list]++;
+  }
+
+  void erase (word_t frame)
+  {
+    next[prev[frame]] = next[frame];
+    prev[next[frame]] = prev[frame];
+    sizes[listed[frame] - 1]--;
+    listed[frame] = 0;
+  }
+
+  // least recently used page of a resident list that is not busy
+  word_t oldest (int list, const std::vector<word_t> &busy) const
+  {
+    for (uint64_t f = prev[head (list)]; f != head (list); f = prev[f])
+    {
+      if (!this->isBusy (f, busy))
+      {
+        return f;
+      }
+    }
+    return 0;
+  }
+
+  // Remember an evicted page, keeping |T1| + |B1| and the whole
+  // directory within the sizes of the algorithm
+  void remember (int ghost, const page_key &page)
+  {
+    ghosts[ghost].push_front (page);
+    index[ghost][page] = ghosts[ghost].begin ();
+    if (sizes[T1] + ghosts[B1].size () > G::numFrames
+        && !ghosts[B1].empty ())
+    {
+      forget (B1, ghosts[B1].back ());
+    }
+    while (sizes[T1] + sizes[T2] + ghosts[B1].size ()
+           + ghosts[B2].size () > 2 * G::numFrames && !ghosts[B2].empty ())
+    {
+      forget (B2, ghosts[B2].back ());
+    }
+  }
+
+  // Move the target size of T1 for a fault on a page remembered in B1 or
+  // B2 and drop the page from there; the ghost list it was in, -1 if none
+  int adapt (const page_key &page)
+  {
+    const uint64_t size1 = ghosts[B1].size ();
+    const uint64_t size2 = ghosts[B2].size ();
+    if (forget (B1, page))
+    {
+      target = std::min<uint64_t> (G::numFrames,
+                                   target + std::max<uint64_t> (
+                                       size1 ? size2 / size1 : 1, 1));
+      return B1;
+    }
+    if (forget (B2, page))
+    {
+      const uint64_t step = std::max<uint64_t> (size2 ? size1 / size2 : 1, 1);
+      target = target > step ? target - step : 0;
+      return B2;
+    }
+    return -1;
+  }
+
+  // Drop a page from a ghost list, false if it was not there
+  bool forget (int ghost, const page_key page)
+  {
+    typename std::map<page_key, ghost_iter>::iterator it
+        = index[ghost].find (page);
+    if (it == index[ghost].end ())
+    {
+      return false;
+    }
+    ghosts[ghost].erase (it->second);
+    index[ghost].erase (it);
+    return true;
+  }
+
+  FrameArray<uint64_t> next;
+  FrameArray<uint64_t> prev;
+  uint64_t sizes[2];
+  std::list<page_key> ghosts[2];
+  std::map<page_key, ghost_iter> index[2];
+  // faulting pages victim already adapted the target for, by the ghost
+  // list they were in, until they are paged in
+  std::map<page_key, int> adapted;
+  // the resident list a frame is in, plus one; 0 if in none
+  FrameArray<uint8_t> listed;
+  FrameArray<uint8_t> fresh;
+  // target size of T1
+  uint64_t target;
+};
+
+template <class G>
+ReplacementPolicy<G> *
+ReplacementPolicy<G>::create (int kind, const FrameArray<frame_info> &frames)
+{
+  switch (kind)
+  {
+    case POLICY_CYCLIC:
+      return new CyclicPolicy<G> (frames);
+    case POLICY_WEIGHTED:
+      return new WeightedPolicy<G> (frames);
+    case POLICY_LRU:
+      return new LruPolicy<G> (frames);
+    case POLICY_CLOCK:
+      return new ClockPolicy<G> (frames);
+    case POLICY_LFU:
+      return new LfuPolicy<G> (frames);
+    case POLICY_ARC:
+      return new ArcPolicy<G> (frames);
+    default:
+      return nullptr;
+  }
+}
@@ -0,0 +1,78 @@
+#include "SlabArena.h"
+#include <cassert>
+#include <cstdlib>
+
+// an object index takes the low bits of a handle, its class the rest
+#define HANDLE_INDEX_BITS 48
+
+
+SlabArena::SlabArena(uint64_t maxBytes)
+    : granule((maxBytes + SLAB_CLASSES - 1) / SLAB_CLASSES),
+      classes(SLAB_CLASSES), usedBytes(0), reservedBytes(0)
+{
+    for (int i = 0; i < SLAB_CLASSES; i++) {
+        classes[i].objectBytes = (i + 1) * granule;
+        classes[i].perSlab = SLAB_BYTES / classes[i].objectBytes;
+        if (classes[i].perSlab == 0)
+            classes[i].perSlab = 1;
+        classes[i].carved = 0;
+    }
+}
+
+SlabArena::~SlabArena() {
+    clear();
+}
+
+int SlabArena::classOf(uint64_t bytes) const {
+    assert(bytes > 0 && bytes <= granule * SLAB_CLASSES);
+    return (int) ((bytes - 1) / granule);
+}
+
+uint64_t SlabArena::allocate(uint64_t bytes) {
+    const int index = classOf(bytes);
+    size_class& sizeClass = classes[index];
+    uint64_t object;
+    if (!sizeClass.released.empty()) {
+        object = sizeClass.released.back();
+        sizeClass.released.pop_back();
+    } else {
+        if (sizeClass.carved == sizeClass.slabs.size() * sizeClass.perSlab) {
+            const uint64_t slabBytes =
+                sizeClass.perSlab * sizeClass.objectBytes;
+            char* slab = static_cast<char*>(malloc(slabBytes));
+            if (slab == nullptr)
+                return SLAB_NO_OBJECT;
+            sizeClass.slabs.push_back(slab);
+            reservedBytes += slabBytes;
+        }
+        object = sizeClass.carved++;
+    }
+    usedBytes += sizeClass.objectBytes;
+    return ((uint64_t) index << HANDLE_INDEX_BITS) | object;
+}
+
+void SlabArena::release(uint64_t handle) {
+    size_class& sizeClass = classes[handle >> HANDLE_INDEX_BITS];
+    sizeClass.released.push_back(handle & ((1ULL << HANDLE_INDEX_BITS) - 1));
+    usedBytes -= sizeClass.objectBytes;
+}
+
+char* SlabArena::at(uint64_t handle) const {
+    const size_class& sizeClass = classes[handle >> HANDLE_INDEX_BITS];
+    const uint64_t object = handle & ((1ULL << HANDLE_INDEX_BITS) - 1);
+    assert(object < sizeClass.carved);
+    return sizeClass.slabs[object / sizeClass.perSlab]
+           + (object % sizeClass.perSlab) * sizeClass.objectBytes;
+}
+
+void SlabArena::clear() {
+    for (size_t i = 0; i < classes.size(); i++) {
+        for (size_t s = 0; s < classes[i].slabs.size(); s++)
+            free(classes[i].slabs[s]);
+        classes[i].slabs.clear();
+        classes[i].released.clear();
+        classes[i].carved = 0;
+    }
+    usedBytes = 0;
+    reservedBytes = 0;
+}
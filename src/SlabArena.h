@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// bytes carved into the objects of one size class at a time
+#define SLAB_BYTES (64ULL << 10)
+// objects of up to maxBytes are served from this many size classes
+#define SLAB_CLASSES 32
+// the handle allocate returns when it cannot get a slab
+#define SLAB_NO_OBJECT (~0ULL)
+
+/*
+ * Allocator for the variable-sized blocks of the compressed swap. Blocks
+ * are rounded up to one of SLAB_CLASSES size classes, each carving
+ * SLAB_BYTES slabs into equal objects, so a block costs no allocation of
+ * its own and freed objects are reused by the next block of their class.
+ * Slabs are only returned on clear.
+ */
+class SlabArena
+{
+public:
+    explicit SlabArena(uint64_t maxBytes);
+    ~SlabArena();
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    /*
+     * returns a handle to an object of at least 'bytes' (0 < bytes <=
+     * maxBytes) bytes, or SLAB_NO_OBJECT if a new slab was needed and
+     * could not be allocated
+     */
+    uint64_t allocate(uint64_t bytes);
+
+    /*
+     * returns the object of a handle to its class
+     */
+    void release(uint64_t handle);
+
+    /*
+     * the first byte of an object, valid until it is released
+     */
+    char* at(uint64_t handle) const;
+
+    /*
+     * releases every object and slab
+     */
+    void clear();
+
+    /*
+     * bytes of the objects handed out and not released, and bytes of all
+     * slabs
+     */
+    uint64_t bytesInUse() const { return usedBytes; }
+    uint64_t bytesReserved() const { return reservedBytes; }
+
+private:
+    typedef struct size_class {
+        uint64_t objectBytes;
+        uint64_t perSlab;
+        std::vector<char*> slabs;
+        // objects released since they were carved
+        std::vector<uint64_t> released;
+        // objects handed out from the slabs so far
+        uint64_t carved;
+    } size_class;
+
+    int classOf(uint64_t bytes) const;
+
+    const uint64_t granule;
+    std::vector<size_class> classes;
+    uint64_t usedBytes;
+    uint64_t reservedBytes;
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#ifdef VM_THREADS
+#include <atomic>
+#endif
+
+// faults that took [2^i, 2^(i+1)) nanoseconds land in bucket i
+#define STATS_LATENCY_BUCKETS 32
+
+/*
+ * A snapshot of the statistics of one physical memory, see
+ * PhysicalMemory::stats and VMgetStats.
+ */
+typedef struct vm_stats{
+  uint64_t faults;               // pages faulted into a frame
+  uint64_t firstTouchFaults;     // of them: first writes, zero-filled
+  uint64_t swapFaults;           // of them: restored from swap
+  uint64_t copyFaults;           // of them: first writes to a page shared
+                                 // with a fork, copied, see
+                                 // FrameTable::fork
+  uint64_t tableFaults;          // missing tables created by a walk
+  uint64_t hugeFaults;           // huge pages mapped by a walk, see
+                                 // FrameTable::setHugePages
+  uint64_t zeroReads;            // reads of never-written pages, served by
+                                 // the zero frame
+  uint64_t evictions;            // pages taken out of RAM
+  uint64_t cleanEvictions;       // of them: unchanged since restored, not
+                                 // written again
+  uint64_t reclaimEvictions;     // of them: done ahead of faults by the
+                                 // reclaimer, see FrameTable::setReclaimer
+  uint64_t emptyTableReuses;     // empty tables taken for a new frame
+  uint64_t freeFrameAllocations; // frames taken off the free list
+  uint64_t faultingWalks;        // translations that faulted at any level
+  uint64_t faultTablesVisited;   // tables those translations went through
+  uint64_t faultReads;           // PMreads of those translations
+  uint64_t prefetches;           // pages faulted in by readahead
+  uint64_t prefetchesUsed;       // of them: accessed while resident
+  uint64_t prefetchesWasted;     // of them: evicted before any access
+  uint64_t pmReads;              // words read, 0 with VM_THREADS
+  uint64_t pmWrites;             // words written, 0 with VM_THREADS
+  uint64_t evictNanoseconds;     // time spent in evictions
+  uint64_t restoreNanoseconds;   // time spent in restores, first touches
+                                 // included
+  uint64_t swappedPages;         // pages in swap now, kept by reset
+  uint64_t swapFootprint;        // bytes their contents take in swap, less
+                                 // than a page each once compressed
+  uint64_t faultLatency[STATS_LATENCY_BUCKETS]; // faulting translations by
+                                                // duration, see above
+}vm_stats;
+
+/*
+ * What one translation cost, gathered while it walks and handed to
+ * StatsCounters::recordWalk once it is done.
+ */
+typedef struct walk_trace{
+  uint64_t tables;               // tables the walk went through
+  uint64_t reads;                // PMreads of the walk
+  uint64_t fills;                // missing entries it filled
+  uint64_t nanoseconds;          // time spent filling them
+  bool failed;                   // the swap device failed, the walk gave up
+}walk_trace;
+
+/*
+ * The counters behind vm_stats. Every counter is bumped on a fault or
+ * less often, except the word counters, so they are cheap enough to stay
+ * on; with VM_THREADS they are relaxed atomics and the word counters are
+ * not kept.
+ */
+class StatsCounters
+{
+public:
+  StatsCounters ()
+  {
+    reset ();
+    recordSwapUsage (0, 0);
+  }
+
+  StatsCounters (const StatsCounters &) = delete;
+  StatsCounters &operator= (const StatsCounters &) = delete;
+
+  void reset ()
+  {
+    counter *all[] = {&faults, &firstTouchFaults, &swapFaults, &copyFaults,
+                      &tableFaults,
+                      &hugeFaults, &zeroReads,
+                      &evictions, &cleanEvictions, &reclaimEvictions,
+                      &emptyTableReuses, &freeFrameAllocations,
+                      &faultingWalks, &faultTablesVisited, &faultReads,
+                      &prefetches, &prefetchesUsed, &prefetchesWasted,
+                      &pmReads, &pmWrites, &evictNanoseconds,
+                      &restoreNanoseconds};
+    for (size_t i = 0; i < sizeof (all) / sizeof (all[0]); ++i)
+    {
+      set (*all[i], 0);
+    }
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+    {
+      set (faultLatency[i], 0);
+    }
+  }
+
+  void snapshot (vm_stats *stats) const
+  {
+    stats->faults = get (faults);
+    stats->firstTouchFaults = get (firstTouchFaults);
+    stats->swapFaults = get (swapFaults);
+    stats->copyFaults = get (copyFaults);
+    stats->tableFaults = get (tableFaults);
+    stats->hugeFaults = get (hugeFaults);
+    stats->zeroReads = get (zeroReads);
+    stats->evictions = get (evictions);
+    stats->cleanEvictions = get (cleanEvictions);
+    stats->reclaimEvictions = get (reclaimEvictions);
+    stats->emptyTableReuses = get (emptyTableReuses);
+    stats->freeFrameAllocations = get (freeFrameAllocations);
+    stats->faultingWalks = get (faultingWalks);
+    stats->faultTablesVisited = get (faultTablesVisited);
+    stats->faultReads = get (faultReads);
+    stats->prefetches = get (prefetches);
+    stats->prefetchesUsed = get (prefetchesUsed);
+    stats->prefetchesWasted = get (prefetchesWasted);
+    stats->pmReads = get (pmReads);
+    stats->pmWrites = get (pmWrites);
+    stats->evictNanoseconds = get (evictNanoseconds);
+    stats->restoreNanoseconds = get (restoreNanoseconds);
+    stats->swappedPages = get (swappedPages);
+    stats->swapFootprint = get (swapFootprint);
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+    {
+      stats->faultLatency[i] = get (faultLatency[i]);
+    }
+  }
+
+  // Count on from a snapshot, as when it was taken. The swap gauges are
+  // left to the next recordSwapUsage.
+  void restore (const vm_stats &stats)
+  {
+    set (faults, stats.faults);
+    set (firstTouchFaults, stats.firstTouchFaults);
+    set (swapFaults, stats.swapFaults);
+    set (copyFaults, stats.copyFaults);
+    set (tableFaults, stats.tableFaults);
+    set (hugeFaults, stats.hugeFaults);
+    set (zeroReads, stats.zeroReads);
+    set (evictions, stats.evictions);
+    set (cleanEvictions, stats.cleanEvictions);
+    set (reclaimEvictions, stats.reclaimEvictions);
+    set (emptyTableReuses, stats.emptyTableReuses);
+    set (freeFrameAllocations, stats.freeFrameAllocations);
+    set (faultingWalks, stats.faultingWalks);
+    set (faultTablesVisited, stats.faultTablesVisited);
+    set (faultReads, stats.faultReads);
+    set (prefetches, stats.prefetches);
+    set (prefetchesUsed, stats.prefetchesUsed);
+    set (prefetchesWasted, stats.prefetchesWasted);
+    set (pmReads, stats.pmReads);
+    set (pmWrites, stats.pmWrites);
+    set (evictNanoseconds, stats.evictNanoseconds);
+    set (restoreNanoseconds, stats.restoreNanoseconds);
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+    {
+      set (faultLatency[i], stats.faultLatency[i]);
+    }
+  }
+
+  // a page came into a frame, restored from swap or seen the first time
+  void recordFault (bool restored)
+  {
+    add (faults, 1);
+    add (restored ? swapFaults : firstTouchFaults, 1);
+  }
+
+  // a page came into a frame as a copy of a page it shared with a fork
+  void recordCopyFault ()
+  {
+    add (faults, 1);
+    add (copyFaults, 1);
+  }
+
+  void recordTableFault ()
+  {
+    add (tableFaults, 1);
+  }
+
+  void recordHugeFault ()
+  {
+    add (hugeFaults, 1);
+  }
+
+  void recordZeroRead ()
+  {
+    add (zeroReads, 1);
+  }
+
+  void recordEviction ()
+  {
+    add (evictions, 1);
+  }
+
+  // an eviction that kept the copy already in swap
+  void recordCleanEviction ()
+  {
+    add (cleanEvictions, 1);
+  }
+
+  void recordReclaimEviction ()
+  {
+    add (reclaimEvictions, 1);
+  }
+
+  void recordEvictTime (uint64_t nanoseconds)
+  {
+    add (evictNanoseconds, nanoseconds);
+  }
+
+  void recordRestoreTime (uint64_t nanoseconds)
+  {
+    add (restoreNanoseconds, nanoseconds);
+  }
+
+  // what the swap holds after a store, load or discard
+  void recordSwapUsage (uint64_t pages, uint64_t bytes)
+  {
+    set (swappedPages, pages);
+    set (swapFootprint, bytes);
+  }
+
+  void recordTableReuse ()
+  {
+    add (emptyTableReuses, 1);
+  }
+
+  void recordFreeFrame ()
+  {
+    add (freeFrameAllocations, 1);
+  }
+
+  // a translation is done; it only counts if it filled an entry
+  void recordWalk (const walk_trace &trace)
+  {
+    if (trace.fills == 0)
+    {
+      return;
+    }
+    add (faultingWalks, 1);
+    add (faultTablesVisited, trace.tables);
+    add (faultReads, trace.reads);
+    int bucket = 0;
+    for (uint64_t ns = trace.nanoseconds; ns > 1
+                                          && bucket < STATS_LATENCY_BUCKETS - 1;
+         ns >>= 1)
+    {
+      ++bucket;
+    }
+    add (faultLatency[bucket], 1);
+  }
+
+  void recordPrefetch ()
+  {
+    add (prefetches, 1);
+  }
+
+  void recordPrefetchUsed ()
+  {
+    add (prefetchesUsed, 1);
+  }
+
+  void recordPrefetchWasted ()
+  {
+    add (prefetchesWasted, 1);
+  }
+
+  void recordRead () const
+  {
+#ifndef VM_THREADS
+    pmReads++;
+#endif
+  }
+
+  void recordWrite ()
+  {
+#ifndef VM_THREADS
+    pmWrites++;
+#endif
+  }
+
+  // a whole-frame scan or clear, counted as that many single words
+  void recordReads (uint64_t words) const
+  {
+#ifndef VM_THREADS
+    pmReads += words;
+#else
+    (void) words;
+#endif
+  }
+
+  void recordWrites (uint64_t words)
+  {
+#ifndef VM_THREADS
+    pmWrites += words;
+#else
+    (void) words;
+#endif
+  }
+
+  uint64_t evictionCount () const
+  {
+    return get (evictions);
+  }
+
+private:
+#ifdef VM_THREADS
+  typedef std::atomic<uint64_t> counter;
+
+  static void add (counter &c, uint64_t n)
+  {
+    c.fetch_add (n, std::memory_order_relaxed);
+  }
+
+  static void set (counter &c, uint64_t n)
+  {
+    c.store (n, std::memory_order_relaxed);
+  }
+
+  static uint64_t get (const counter &c)
+  {
+    return c.load (std::memory_order_relaxed);
+  }
+#else
+  typedef uint64_t counter;
+
+  static void add (counter &c, uint64_t n)
+  {
+    c += n;
+  }
+
+  static void set (counter &c, uint64_t n)
+  {
+    c = n;
+  }
+
+  static uint64_t get (const counter &c)
+  {
+    return c;
+  }
+#endif
+
+  counter faults;
+  counter firstTouchFaults;
+  counter swapFaults;
+  counter copyFaults;
+  counter tableFaults;
+  counter hugeFaults;
+  counter zeroReads;
+  counter evictions;
+  counter cleanEvictions;
+  counter reclaimEvictions;
+  counter emptyTableReuses;
+  counter freeFrameAllocations;
+  counter faultingWalks;
+  counter faultTablesVisited;
+  counter faultReads;
+  counter prefetches;
+  counter prefetchesUsed;
+  counter prefetchesWasted;
+  // bumped by const reads of the RAM
+  mutable counter pmReads;
+  counter pmWrites;
+  counter evictNanoseconds;
+  counter restoreNanoseconds;
+  // gauges, not cleared by reset
+  counter swappedPages;
+  counter swapFootprint;
+  counter faultLatency[STATS_LATENCY_BUCKETS];
+};
@@ -0,0 +1,578 @@
+#include "SwapDevice.h"
+#include "PageCodec.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// the swap file grows and is mapped in windows of this many bytes
+#define SWAP_WINDOW_BYTES (64ULL << 20)
+
+// pread and pwrite of a whole page, resumed after short transfers and
+// signals
+static bool readFull(int fd, void* buffer, uint64_t bytes, uint64_t offset) {
+    char* at = static_cast<char*>(buffer);
+    while (bytes > 0) {
+        const ssize_t done = pread(fd, at, bytes, offset);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+        at += done;
+        bytes -= done;
+        offset += done;
+    }
+    return true;
+}
+
+static bool writeFull(int fd, const void* buffer, uint64_t bytes,
+                      uint64_t offset) {
+    const char* at = static_cast<const char*>(buffer);
+    while (bytes > 0) {
+        const ssize_t done = pwrite(fd, at, bytes, offset);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+        at += done;
+        bytes -= done;
+        offset += done;
+    }
+    return true;
+}
+
+
+SwapDevice::SwapDevice(uint64_t pageWords)
+    : pageBytes(pageWords * sizeof(word_t)),
+      windowSlots((SWAP_WINDOW_BYTES + pageBytes - 1) / pageBytes),
+      backend(SWAP_MEMORY), writtenBytes(0), readBytes(0), arena(pageBytes),
+      fd(-1), usedSlots(0), capacitySlots(0)
+#ifdef PM_IO_URING
+      , ringReady(false), ringFailed(false), staging(nullptr)
+#endif
+{
+}
+
+SwapDevice::~SwapDevice() {
+    closeFile();
+}
+
+#ifdef PM_IO_URING
+bool SwapDevice::openRing() {
+    if (io_uring_queue_init(SWAP_URING_DEPTH, &ring, 0) != 0)
+        return false;
+    void* buffers = nullptr;
+    if (posix_memalign(&buffers, 4096, SWAP_URING_DEPTH * pageBytes) != 0) {
+        io_uring_queue_exit(&ring);
+        return false;
+    }
+    staging = static_cast<word_t*>(buffers);
+    freeStaging.clear();
+    for (int i = SWAP_URING_DEPTH - 1; i >= 0; i--) {
+        stagingBusy[i] = false;
+        freeStaging.push_back(i);
+    }
+    ringReady = true;
+    ringFailed = false;
+    return true;
+}
+
+void SwapDevice::closeRing() {
+    if (!ringReady)
+        return;
+    drainWrites();
+    io_uring_queue_exit(&ring);
+    free(staging);
+    staging = nullptr;
+    ringReady = false;
+}
+
+// waits for one write to complete and frees its staging buffer; the slot
+// of a write that failed is remembered for the load of its page. false if
+// the ring itself failed, see failRing
+bool SwapDevice::reapWrite() {
+    if (ringFailed)
+        return false;
+    struct io_uring_cqe* cqe;
+    int error;
+    do {
+        error = io_uring_wait_cqe(&ring, &cqe);
+    } while (error == -EINTR);
+    if (error != 0) {
+        failRing();
+        return false;
+    }
+    const int buffer = (int) (uintptr_t) io_uring_cqe_get_data(cqe);
+    if (cqe->res != (int) pageBytes)
+        failedSlots.insert(stagingSlot[buffer]);
+    io_uring_cqe_seen(&ring, cqe);
+    stagingBusy[buffer] = false;
+    freeStaging.push_back(buffer);
+    return true;
+}
+
+// the ring cannot be waited on or submitted to: the writes in flight
+// cannot be told apart, so all of them count as failed, and their staging
+// buffers stay busy as the kernel may still read them. No write is queued
+// after this, every later store fails
+void SwapDevice::failRing() {
+    ringFailed = true;
+    for (int i = 0; i < SWAP_URING_DEPTH; i++)
+        if (stagingBusy[i])
+            failedSlots.insert(stagingSlot[i]);
+}
+
+void SwapDevice::drainWrites() {
+    while (freeStaging.size() < SWAP_URING_DEPTH)
+        if (!reapWrite())
+            return;
+}
+
+bool SwapDevice::writePending(uint64_t slot) const {
+    for (int i = 0; i < SWAP_URING_DEPTH; i++)
+        if (stagingBusy[i] && stagingSlot[i] == slot)
+            return true;
+    return false;
+}
+
+// queues the write of a page to a slot; false, with the slot failed, if
+// there is no staging buffer or submission entry for it
+bool SwapDevice::queueWrite(uint64_t slot, const word_t* page) {
+    if (freeStaging.empty())
+        reapWrite();
+    struct io_uring_sqe* sqe = nullptr;
+    if (!ringFailed && !freeStaging.empty())
+        sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr) {
+        failedSlots.insert(slot);
+        return false;
+    }
+    failedSlots.erase(slot);
+    const int buffer = freeStaging.back();
+    freeStaging.pop_back();
+    word_t* copy = staging + buffer * (pageBytes / sizeof(word_t));
+    memcpy(copy, page, pageBytes);
+    stagingSlot[buffer] = slot;
+    stagingBusy[buffer] = true;
+
+    io_uring_prep_write(sqe, fd, copy, pageBytes, slot * pageBytes);
+    io_uring_sqe_set_data(sqe, (void*) (uintptr_t) buffer);
+    if (io_uring_submit(&ring) < 0) {
+        failRing();
+        return false;
+    }
+    return true;
+}
+#endif
+
+void SwapDevice::unmapWindows() {
+    for (size_t i = 0; i < windows.size(); i++)
+        if (windows[i] != nullptr)
+            munmap(windows[i], windowSlots * pageBytes);
+    windows.clear();
+}
+
+// returns the address of a slot, mapping the window that contains it,
+// or nullptr if the window cannot be mapped. The address stays valid
+// until the file is closed, so the page is copied without the lock
+char* SwapDevice::mapSlot(uint64_t slot) {
+    const uint64_t index = slot / windowSlots;
+    if (index >= windows.size())
+        windows.resize(index + 1, nullptr);
+    if (windows[index] == nullptr) {
+        void* mapped = mmap(nullptr, windowSlots * pageBytes,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                            index * windowSlots * pageBytes);
+        if (mapped == MAP_FAILED)
+            return nullptr;
+        windows[index] = static_cast<char*>(mapped);
+    }
+    return windows[index] + (slot % windowSlots) * pageBytes;
+}
+
+void SwapDevice::closeFile() {
+#ifdef PM_IO_URING
+    closeRing();
+    failedSlots.clear();
+#endif
+    unmapWindows();
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+    slots.clear();
+    freeSlots.clear();
+    usedSlots = 0;
+    capacitySlots = 0;
+}
+
+// preallocates one more window of slots at the end of a swap file that
+// holds 'capacity' slots, false if the file system refuses
+bool SwapDevice::growFile(int file, uint64_t capacity) {
+    return posix_fallocate(file, capacity * pageBytes,
+                           windowSlots * pageBytes) == 0;
+}
+
+bool SwapDevice::takeSlot(uint64_t* slot) {
+    if (!freeSlots.empty()) {
+        *slot = freeSlots.back();
+        freeSlots.pop_back();
+        return true;
+    }
+    if (usedSlots == capacitySlots) {
+        if (!growFile(fd, capacitySlots))
+            return false;
+        capacitySlots += windowSlots;
+    }
+    *slot = usedSlots++;
+    return true;
+}
+
+// packs a page into the arena, replacing its previous copy; false if the
+// arena has no room for it, the previous copy is then dropped too. The
+// page is packed and copied to the arena without the lock
+bool SwapDevice::storePacked(uint64_t pageIndex, const word_t* page) {
+    static thread_local std::vector<unsigned char> scratch;
+    if (scratch.size() < pageBytes)
+        scratch.resize(pageBytes);
+    packed_page copy;
+    uint64_t bytes = 0;
+    copy.kind = packPage(page, pageBytes / sizeof(word_t), scratch.data(),
+                         &bytes, &copy.same);
+    copy.bytes = (uint32_t) bytes;
+    copy.handle = 0;
+#ifdef VM_THREADS
+    std::unique_lock<std::mutex> guard(lock);
+#endif
+    if (copy.kind != PACK_SAME) {
+        copy.handle = arena.allocate(bytes);
+        if (copy.handle == SLAB_NO_OBJECT) {
+            std::unordered_map<uint64_t, packed_page>::iterator stale =
+                packed.find(pageIndex);
+            if (stale != packed.end()) {
+                dropPacked(stale->second);
+                packed.erase(stale);
+            }
+            return false;
+        }
+    }
+    std::pair<std::unordered_map<uint64_t, packed_page>::iterator, bool>
+        slot = packed.insert(std::make_pair(pageIndex, copy));
+    if (!slot.second) {
+        dropPacked(slot.first->second);
+        slot.first->second = copy;
+    }
+    writtenBytes += bytes;
+    if (copy.kind == PACK_SAME)
+        return true;
+    char* const at = arena.at(copy.handle);
+#ifdef VM_THREADS
+    guard.unlock();
+#endif
+    memcpy(at, scratch.data(), bytes);
+    return true;
+}
+
+void SwapDevice::dropPacked(const packed_page& copy) {
+    if (copy.kind != PACK_SAME)
+        arena.release(copy.handle);
+}
+
+int SwapDevice::initialize(int newBackend, const char* path) {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    int newFd = -1;
+    if (newBackend != SWAP_MEMORY && newBackend != SWAP_COMPRESSED) {
+        if (path == nullptr)
+            return 0;
+        newFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (newFd < 0)
+            return 0;
+        if (!growFile(newFd, 0)) {
+            close(newFd);
+            return 0;
+        }
+    }
+    closeFile();
+    pages.clear();
+    packed.clear();
+    arena.clear();
+    fd = newFd;
+    backend = newBackend;
+#ifdef PM_IO_URING
+    if (backend == SWAP_URING && !openRing())
+        backend = SWAP_PREAD;
+#else
+    if (backend == SWAP_URING)
+        backend = SWAP_PREAD;
+#endif
+    if (fd >= 0)
+        capacitySlots = windowSlots;
+    writtenBytes = 0;
+    readBytes = 0;
+    return 1;
+}
+
+int SwapDevice::contains(uint64_t pageIndex) const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (backend == SWAP_MEMORY)
+        return pages.find(pageIndex) != pages.end();
+    if (backend == SWAP_COMPRESSED)
+        return packed.find(pageIndex) != packed.end();
+    return slots.find(pageIndex) != slots.end();
+}
+
+uint64_t SwapDevice::countPages() const {
+    if (backend == SWAP_MEMORY)
+        return pages.size();
+    if (backend == SWAP_COMPRESSED)
+        return packed.size();
+    return slots.size();
+}
+
+uint64_t SwapDevice::pageCount() const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    return countPages();
+}
+
+std::vector<uint64_t> SwapDevice::pageIndexes() const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    std::vector<uint64_t> indexes;
+    indexes.reserve(countPages());
+    if (backend == SWAP_MEMORY) {
+        for (std::unordered_map<uint64_t, page_t>::const_iterator copy =
+                 pages.begin(); copy != pages.end(); ++copy)
+            indexes.push_back(copy->first);
+    } else if (backend == SWAP_COMPRESSED) {
+        for (std::unordered_map<uint64_t, packed_page>::const_iterator copy =
+                 packed.begin(); copy != packed.end(); ++copy)
+            indexes.push_back(copy->first);
+    } else {
+        for (std::unordered_map<uint64_t, uint64_t>::const_iterator slot =
+                 slots.begin(); slot != slots.end(); ++slot)
+            indexes.push_back(slot->first);
+    }
+    std::sort(indexes.begin(), indexes.end());
+    return indexes;
+}
+
+uint64_t SwapDevice::footprint() const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (backend == SWAP_COMPRESSED)
+        return arena.bytesInUse();
+    return countPages() * pageBytes;
+}
+
+uint64_t SwapDevice::bytesWritten() const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    return writtenBytes;
+}
+
+uint64_t SwapDevice::bytesRead() const {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    return readBytes;
+}
+
+int SwapDevice::store(uint64_t pageIndex, const word_t* page) {
+    if (backend == SWAP_COMPRESSED)
+        return storePacked(pageIndex, page) ? 1 : 0;
+#ifdef VM_THREADS
+    std::unique_lock<std::mutex> guard(lock);
+#endif
+    if (backend == SWAP_MEMORY) {
+        page_t& copy = pages[pageIndex];
+        copy.resize(pageBytes / sizeof(word_t));
+        writtenBytes += pageBytes;
+        word_t* const to = copy.data();
+#ifdef VM_THREADS
+        guard.unlock();
+#endif
+        memcpy(to, page, pageBytes);
+        return 1;
+    }
+    std::unordered_map<uint64_t, uint64_t>::iterator slot =
+        slots.find(pageIndex);
+    if (slot == slots.end()) {
+        uint64_t taken;
+        if (!takeSlot(&taken))
+            return 0;
+        slot = slots.insert(std::make_pair(pageIndex, taken)).first;
+    }
+#ifdef PM_IO_URING
+    // two writes in flight to one slot may land in either order
+    else if (backend == SWAP_URING && writePending(slot->second))
+        drainWrites();
+#endif
+    const uint64_t taken = slot->second;
+    writtenBytes += pageBytes;
+    bool written;
+    if (backend == SWAP_MMAP) {
+        char* const at = mapSlot(taken);
+        written = at != nullptr;
+#ifdef VM_THREADS
+        guard.unlock();
+#endif
+        if (written)
+            memcpy(at, page, pageBytes);
+    }
+#ifdef PM_IO_URING
+    // the ring is not thread-safe: the page is copied to its staging
+    // buffer with the lock, the write itself completes behind it
+    else if (backend == SWAP_URING) {
+        written = queueWrite(taken, page);
+    }
+#endif
+    else {
+#ifdef VM_THREADS
+        guard.unlock();
+#endif
+        written = writeFull(fd, page, pageBytes, taken * pageBytes);
+    }
+    if (written)
+        return 1;
+#ifdef VM_THREADS
+    if (!guard.owns_lock())
+        guard.lock();
+#endif
+    // the slot may hold part of the page now: it goes with the copy
+    freeSlots.push_back(taken);
+    slots.erase(pageIndex);
+    writtenBytes -= pageBytes;
+    return 0;
+}
+
+int SwapDevice::load(uint64_t pageIndex, word_t* page) {
+#ifdef VM_THREADS
+    std::unique_lock<std::mutex> guard(lock);
+#endif
+    if (backend == SWAP_MEMORY) {
+        std::unordered_map<uint64_t, page_t>::const_iterator copy =
+            pages.find(pageIndex);
+        if (copy == pages.end())
+            return 0;
+        const word_t* const from = copy->second.data();
+        readBytes += pageBytes;
+#ifdef VM_THREADS
+        guard.unlock();
+#endif
+        memcpy(page, from, pageBytes);
+        return 1;
+    }
+    if (backend == SWAP_COMPRESSED) {
+        std::unordered_map<uint64_t, packed_page>::const_iterator copy =
+            packed.find(pageIndex);
+        if (copy == packed.end())
+            return 0;
+        const packed_page entry = copy->second;
+        const unsigned char* bytes = nullptr;
+        if (entry.kind != PACK_SAME)
+            bytes = reinterpret_cast<unsigned char*>(arena.at(entry.handle));
+        readBytes += entry.bytes;
+#ifdef VM_THREADS
+        guard.unlock();
+#endif
+        if (unpackPage(entry.kind, bytes, entry.bytes, entry.same, page,
+                       pageBytes / sizeof(word_t)))
+            return 1;
+#ifdef VM_THREADS
+        guard.lock();
+#endif
+        readBytes -= entry.bytes;
+        return -1;
+    }
+    std::unordered_map<uint64_t, uint64_t>::const_iterator slot =
+        slots.find(pageIndex);
+    if (slot == slots.end())
+        return 0;
+    const uint64_t taken = slot->second;
+#ifdef PM_IO_URING
+    if (backend == SWAP_URING) {
+        if (writePending(taken))
+            drainWrites();
+        if (failedSlots.count(taken) != 0)
+            return -1;
+    }
+#endif
+    const char* at = nullptr;
+    if (backend == SWAP_MMAP) {
+        at = mapSlot(taken);
+        if (at == nullptr)
+            return -1;
+    }
+    readBytes += pageBytes;
+#ifdef VM_THREADS
+    guard.unlock();
+#endif
+    if (at != nullptr) {
+        memcpy(page, at, pageBytes);
+        return 1;
+    }
+    if (readFull(fd, page, pageBytes, taken * pageBytes))
+        return 1;
+#ifdef VM_THREADS
+    guard.lock();
+#endif
+    readBytes -= pageBytes;
+    return -1;
+}
+
+void SwapDevice::discard(uint64_t firstIndex, uint64_t lastIndex) {
+#ifdef VM_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    if (backend == SWAP_MEMORY) {
+        std::unordered_map<uint64_t, page_t>::iterator copy = pages.begin();
+        while (copy != pages.end()) {
+            if (copy->first >= firstIndex && copy->first <= lastIndex)
+                copy = pages.erase(copy);
+            else
+                ++copy;
+        }
+        return;
+    }
+    if (backend == SWAP_COMPRESSED) {
+        std::unordered_map<uint64_t, packed_page>::iterator copy =
+            packed.begin();
+        while (copy != packed.end()) {
+            if (copy->first >= firstIndex && copy->first <= lastIndex) {
+                dropPacked(copy->second);
+                copy = packed.erase(copy);
+            } else {
+                ++copy;
+            }
+        }
+        return;
+    }
+#ifdef PM_IO_URING
+    // a freed slot may be reused before its old write lands
+    if (backend == SWAP_URING)
+        drainWrites();
+#endif
+    std::unordered_map<uint64_t, uint64_t>::iterator slot = slots.begin();
+    while (slot != slots.end()) {
+        if (slot->first >= firstIndex && slot->first <= lastIndex) {
+#ifdef PM_IO_URING
+            failedSlots.erase(slot->second);
+#endif
+            freeSlots.push_back(slot->second);
+            slot = slots.erase(slot);
+        } else {
+            ++slot;
+        }
+    }
+}
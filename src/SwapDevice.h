@@ -0,0 +1,178 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#include "SlabArena.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef VM_THREADS
+#include <mutex>
+#endif
+#ifdef PM_IO_URING
+#include <liburing.h>
+#endif
+
+// swap backends, where evicted pages are kept
+#define SWAP_MEMORY 0   // in process memory
+#define SWAP_PREAD 1    // preallocated file, one pread/pwrite per page
+#define SWAP_MMAP 2     // preallocated file, copied through mmap windows
+#define SWAP_URING 3    // preallocated file, writes queued through io_uring
+#define SWAP_COMPRESSED 4 // in process memory, packed, see PageCodec.h
+
+// number of evictions that may be in flight with SWAP_URING
+#define SWAP_URING_DEPTH 64
+
+/*
+ * Backing store for the pages evicted from one physical memory.
+ * Every page is pageWords words long.
+ * With VM_THREADS the pages are stored, loaded and discarded from many
+ * threads at once: a lock is held while a page's slot or copy is found or
+ * taken, and the page is copied, packed, read or written without it. A
+ * page must not be stored, loaded or discarded by two threads at once.
+ */
+class SwapDevice
+{
+public:
+    explicit SwapDevice(uint64_t pageWords);
+    ~SwapDevice();
+    SwapDevice(const SwapDevice&) = delete;
+    SwapDevice& operator=(const SwapDevice&) = delete;
+
+    /*
+     * selects the swap backend and drops every page stored so far.
+     * 'path' is ignored by the in-memory backends; file backends create
+     * (or truncate) the file at 'path' and keep pages in slots of it, so
+     * only the slot index of a page stays in process memory. SWAP_URING
+     * falls back to SWAP_PREAD when built without PM_IO_URING.
+     *
+     * returns 1 on success.
+     * returns 0 if 'path' is null for a file backend or the swap file
+     * could not be set up, the previous backend is then left in place.
+     */
+    int initialize(int backend, const char* path);
+
+    /*
+     * returns 1 if the page is currently stored in swap, 0 otherwise
+     */
+    int contains(uint64_t pageIndex) const;
+
+    /*
+     * stores a copy of the page words at 'page' as the swapped page,
+     * replacing the copy stored before, if any.
+     * returns 1 on success, 0 if the swap file could not be grown or
+     * written, SWAP_URING could not queue the write or SWAP_COMPRESSED got
+     * no memory for the packed page; the page then has no copy in swap,
+     * not even the one stored before. With SWAP_URING a write that fails
+     * once queued is only noticed by the load of its page
+     */
+    int store(uint64_t pageIndex, const word_t* page);
+
+    /*
+     * copies the swapped page into the page words at 'page'. the copy stays
+     * in swap until the page is stored again or discarded, so a page that
+     * is not written while in RAM need not be stored again.
+     * returns 1 on success, 0 if the page is not in swap ('page' is untouched)
+     * and -1 if the swap file could not be read
+     */
+    int load(uint64_t pageIndex, word_t* page);
+
+    /*
+     * drops every stored page whose index lies in [firstIndex, lastIndex]
+     * without reading it back
+     */
+    void discard(uint64_t firstIndex, uint64_t lastIndex);
+
+    /*
+     * number of pages stored, and the bytes their contents take in the
+     * backend: a page each, except with SWAP_COMPRESSED
+     */
+    uint64_t pageCount() const;
+    uint64_t footprint() const;
+
+    /*
+     * indexes of the stored pages, in increasing order
+     */
+    std::vector<uint64_t> pageIndexes() const;
+
+    /*
+     * bytes moved to and from the backend since the last initialize,
+     * after packing with SWAP_COMPRESSED
+     */
+    uint64_t bytesWritten() const;
+    uint64_t bytesRead() const;
+
+private:
+    typedef std::vector<word_t> page_t;
+
+    // a page kept by SWAP_COMPRESSED
+    typedef struct packed_page {
+        uint64_t handle;        // arena object, unless PACK_SAME
+        uint32_t bytes;         // bytes used in it
+        int kind;               // PACK_SAME, PACK_DELTA or PACK_RAW
+        word_t same;            // the value of a PACK_SAME page
+    } packed_page;
+
+    void closeFile();
+    bool growFile(int file, uint64_t capacity);
+    bool takeSlot(uint64_t* slot);
+    char* mapSlot(uint64_t slot);
+    void unmapWindows();
+    uint64_t countPages() const;
+    bool storePacked(uint64_t pageIndex, const word_t* page);
+    void dropPacked(const packed_page& copy);
+#ifdef PM_IO_URING
+    bool openRing();
+    void closeRing();
+    bool reapWrite();
+    void failRing();
+    void drainWrites();
+    bool writePending(uint64_t slot) const;
+    bool queueWrite(uint64_t slot, const word_t* page);
+#endif
+
+    const uint64_t pageBytes;
+    // the swap file grows and is mapped in windows of this many slots
+    const uint64_t windowSlots;
+    int backend;
+    uint64_t writtenBytes;
+    uint64_t readBytes;
+
+    // SWAP_MEMORY: page contents by page index
+    std::unordered_map<uint64_t, page_t> pages;
+
+    // SWAP_COMPRESSED: packed pages by page index, their bytes in the
+    // arena
+    std::unordered_map<uint64_t, packed_page> packed;
+    SlabArena arena;
+
+    // file backends: slot of every swapped page, reused once discarded
+    int fd;
+    std::unordered_map<uint64_t, uint64_t> slots;
+    std::vector<uint64_t> freeSlots;
+    uint64_t usedSlots;
+    uint64_t capacitySlots;
+
+    // SWAP_MMAP: the windows mapped so far by index, nullptr if not yet;
+    // they stay mapped until the file is closed
+    std::vector<char*> windows;
+
+#ifdef PM_IO_URING
+    // SWAP_URING: evicted pages are copied to a staging buffer and written
+    // behind; a restore of a page still in flight waits for the queue
+    struct io_uring ring;
+    bool ringReady;
+    // the ring failed, see failRing
+    bool ringFailed;
+    word_t* staging;
+    uint64_t stagingSlot[SWAP_URING_DEPTH];
+    bool stagingBusy[SWAP_URING_DEPTH];
+    std::vector<int> freeStaging;
+    // slots whose queued write failed, until stored again or discarded
+    std::unordered_set<uint64_t> failedSlots;
+#endif
+
+#ifdef VM_THREADS
+    // guards everything above but the page contents
+    mutable std::mutex lock;
+#endif
+};
@@ -2,343 +2,151 @@
 #include "PhysicalMemory.h"
 
 
-#define SUCCESS 1
-#define FAILURE 0
-
-/**
- * Struct to track state during DFS frame search
- * Used by the eviction algorithm to find optimal page to evict
- */
-typedef struct dfs_attributes{
-  word_t maxFrame;           // Highest frame number seen
-  uint64_t maxDistance;      // Max cyclic distance found
-  word_t parentTable;        // Parent of eviction candidate
-  word_t offset;             // Offset in parent table
-  word_t cyclicFrame;        // Frame to evict
-  uint64_t pageAddress;      // Current page being examined
-  uint64_t cyclicPage;       // Page number to evict
-}dfs_attributes;
+// the memory behind the PM* functions and the address space behind the
+// VM* functions, with the geometry of MemoryConstants.h. Both are defined
+// here so the RAM exists before the address space and outlives it; the
+// RAM is allocated during static initialization, and if that fails
+// VMinitialize does, leaving the VM* accessors to fail as before it
+PhysicalMemory<DefaultGeometry> physicalMemory;
+AddressSpace<DefaultGeometry> virtualMemory (physicalMemory);
 
 // ============================================================================
-// INTERNAL FUNCTIONS
+// PUBLIC API
 // ============================================================================
 
-// extract the part of the binary number from start (inclusive) to end (exclusive)
-uint64_t extractBits(const uint64_t number, const uint64_t start, const uint64_t end) {
-  if (start >= end || end > 64) {
-    return 0;
-  }
-  const uint64_t mask = ((1LL << (end - start)) - 1) << start;
-  return (number & mask) >> start;
+/** Initialize the virtual memory by clearing root page table.
+ * Must be called before any VMread or VMwrite operations.
+ * @return 1 on success and 0 if the RAM could not be allocated
+ */
+int VMinitialize(){
+  return virtualMemory.initialize ();
 }
 
-// Check if frame is not in the current traversal path
-bool notOccupied(const int* occupied, const int frame){
-  for (int i = 0; i < TABLES_DEPTH; ++i)
-  {
-    if (occupied[i] == frame)
-    {
-      return false;
-    }
-  }
-  return true;
+/** Initialize the virtual memory with evicted pages kept by the given
+ * swap backend, dropping everything swapped out so far.
+ * @return 1 on success and 0 if the swap file could not be set up or
+ * the RAM could not be allocated
+ */
+int VMinitialize(int swapBackend, const char* swapPath){
+  return virtualMemory.initialize (swapBackend, swapPath);
 }
 
-// Mark frame as occupied
-void makeOccupied(int* occupied, int frame){
-  for (int i = 0; i < TABLES_DEPTH; ++i)
-  {
-    if (occupied[i] == 0){
-      occupied[i] = frame;
-      break;
-    }
-  }
+/** reads a word from the given virtual address
+ * and puts its content in value.
+ * @return 1 on success and 0 on failure (if the address cannot be mapped to a physical
+ * address for any reason)
+ */
+int VMread(uint64_t virtualAddress, word_t* value){
+  return virtualMemory.read (virtualAddress, value);
 }
 
-// Calculate minimum cyclic distance between two pages
-uint64_t minCyclic(const uint64_t page_swapped_in, const uint64_t p){
-  const uint64_t distance = page_swapped_in > p ? page_swapped_in - p : p - page_swapped_in;
-  const uint64_t cyclic_distance = NUM_PAGES - distance;
-  return cyclic_distance < distance ? cyclic_distance : distance;
+/** writes a word to the given virtual address
+ * @return 1 on success and 0 on failure (if the address cannot be mapped to a physical
+ * address for any reason)
+ */
+int VMwrite(uint64_t virtualAddress, word_t value){
+  return virtualMemory.write (virtualAddress, value);
 }
 
-// Update page address during DFS traversal
-uint64_t modifyPageAddress(dfs_attributes* attributes, int i,
-                       uint64_t maxValue, uint64_t layerSize){
-  uint64_t sum = 0;
-  for (uint64_t j = layerSize-1; j >= 0; --j)
-  {
-    uint64_t x = extractBits (i, j, j+1);
-    sum += x * maxValue;
-    attributes->pageAddress += x * maxValue;
-    maxValue /= (1LL << 1);
-    if (j == 0){
-      return sum;
-    }
-  }
+/** number of translations served from the translation cache
+ */
+uint64_t VMtlbHits(){
+  return virtualMemory.tlbHitCount ();
 }
 
-/**
- * DFS to find page with maximum cyclic distance for eviction.
- * Also tracks the maximum frame number encountered.
+/** number of translations that had to walk the page tables
  */
-void dfs (int layer, word_t *value, word_t cur_frame, uint64_t
-page_swapped_in, dfs_attributes *attributes, uint64_t* maxValue, uint64_t 
-*layerSize)
-{
-  if (layer >= TABLES_DEPTH)
-  {
-    return;
-  }
-  if (layer == TABLES_DEPTH-1){
-    for (int i = 0; i < PAGE_SIZE; ++i)
-    {
-      PMread ((cur_frame * PAGE_SIZE) + i, value);
-      if (*value != 0)
-      {
-       uint64_t sum = modifyPageAddress (attributes, i, maxValue[layer],
-                                         layerSize[layer]);
-        uint64_t x = minCyclic (page_swapped_in, attributes->pageAddress);
-        if (x > attributes->maxDistance)
-        {
-          attributes->maxDistance = x;
-          attributes->cyclicFrame = *value;
-          attributes->parentTable = cur_frame;
-          attributes->offset = i;
-          attributes->cyclicPage = attributes->pageAddress;
-        }
-        attributes->pageAddress -= sum;
-      }
-    }
-  }
-  for (int i = 0; i < PAGE_SIZE; ++i)
-  {
-    PMread ((cur_frame * PAGE_SIZE) + i, value);
-    if (*value == 0)
-    {
-      continue;
-    }
-    uint64_t sum = modifyPageAddress(attributes, i, maxValue[layer],
-                                     layerSize[layer]);
-    if (attributes->maxFrame < *value)
-    {
-      attributes->maxFrame = *value;
-    }
-    dfs (layer + 1, value, *value, page_swapped_in, attributes, maxValue, 
-         layerSize);
-    attributes->pageAddress -= sum;
-  }
+uint64_t VMtlbMisses(){
+  return virtualMemory.tlbMissCount ();
 }
 
-/**
- * Search for completely empty page table to reuse.
- * Returns frame number if found, 0 otherwise.
+/** chooses the page replacement policy of the physical memory
+ * @return 1 on success and 0 if policy is not a POLICY_* value
  */
-word_t findEmptyTable (int layer, word_t *value, int cur_frame, int
-                          *child_changed, int *occupied)
-{
-  if (layer >= TABLES_DEPTH)
-  {
-    return 0;
-  }
-  if (notOccupied (occupied, cur_frame))
-  {
-    int zero_entries_in_table = 0;
-    for (int i = 0; i < PAGE_SIZE; ++i)
-    {
-      PMread ((cur_frame * PAGE_SIZE) + i, value);
-      if (*value != 0)
-      {
-        break;
-      }
-      zero_entries_in_table++;
-    }
-    if (zero_entries_in_table == PAGE_SIZE)
-    {
-      *child_changed = 1;
-      return cur_frame;
-    }
-  }
-  for (int i = 0; i < PAGE_SIZE; ++i)
-  {
-    PMread ((cur_frame * PAGE_SIZE) + i, value);
-    if (*value == 0)
-    {
-      continue;
-    }
-    word_t p = findEmptyTable (layer+1, value, *value, child_changed,
-                                 occupied);
-    if (p==0){
-      continue;
-    }
-    if (*child_changed){
-      *child_changed = 0;
-      PMwrite ((cur_frame * PAGE_SIZE) + i, 0);
-    }
-    return p;
-  }
-  return 0;
+int VMsetReplacementPolicy(int policy){
+  return physicalMemory.frameTable ().setPolicy (policy);
 }
 
-/**
- * Find available frame using three-tier strategy:
- * 1. Search for empty table to reuse
- * 2. Allocate new unused frame if available
- * 3. Evict page with maximum cyclic distance
+/** keeps between low and high free frames with a reclaimer thread,
+ * 0, 0 stops it
+ * @return 1 on success and 0 if the reclaimer is not available
  */
-word_t findEmptyFrame(int *occupied, uint64_t page_swapped_in, uint64_t 
-                      *maxValue, uint64_t *layerSize){
-  word_t value;
-  int child_changed = 0;
-  word_t frame = findEmptyTable (0, &value, 0, &child_changed, occupied);
-  if (frame != 0){
-    makeOccupied (occupied, frame);
-    return frame;
-  }
-  dfs_attributes attributes = {0};
-  dfs (0, &value, 0, page_swapped_in, &attributes, maxValue, layerSize);
-  if (attributes.maxFrame+1 < NUM_FRAMES && notOccupied (occupied,
-                                                          attributes
-                                                          .maxFrame+1)){
-    makeOccupied (occupied, attributes.maxFrame+1);
-    return attributes.maxFrame+1;
-  }
-  PMevict (attributes.cyclicFrame, attributes.cyclicPage);
-  PMwrite ((attributes.parentTable * PAGE_SIZE) + attributes.offset, 0);
-  makeOccupied (occupied, attributes.cyclicFrame);
-  return attributes.cyclicFrame;
+int VMsetReclaimer(uint64_t low, uint64_t high){
+  return physicalMemory.frameTable ().setReclaimer (low, high);
 }
 
-// Distribute address bits evenly across page table layers
-void determineLayerSize (const uint64_t address, uint64_t *sizes_array)
-{
-  const uint64_t extra = address % TABLES_DEPTH;
-  const uint64_t base = address / TABLES_DEPTH;
-  for (unsigned int i = 0; i < TABLES_DEPTH; ++i)
-  {
-    sizes_array[i] = base;
-    if (i < extra){
-      sizes_array[i]++;
-    }
-  }
+/** maps dense regions with huge pages from now on, or stops doing so
+ * @return 1 on success and 0 if huge pages are not available
+ */
+int VMsetHugePages(int enable){
+  return physicalMemory.frameTable ().setHugePages (enable != 0);
 }
 
-// Extract index for specific layer from virtual address
-uint64_t determineAddress (int layer, const uint64_t *layerSize, uint64_t address)
-{
-  uint64_t sum = 0;
-  for (int i = 0; i <= layer; ++i)
-  {
-    sum += layerSize[i];
-  }
-  if (layer == 0){
-    return extractBits (address, VIRTUAL_ADDRESS_WIDTH-layerSize[1],
-                        VIRTUAL_ADDRESS_WIDTH);
-  }
-  return extractBits (address, VIRTUAL_ADDRESS_WIDTH - sum,
-                      (VIRTUAL_ADDRESS_WIDTH - sum) + layerSize[layer]);
+/** reads up to maxPages pages ahead of fault streams, 0 turns it off
+ * @return 1 on success and 0 if readahead is not available
+ */
+int VMsetReadahead(uint64_t maxPages){
+  return virtualMemory.setReadahead (maxPages);
 }
 
-// Calculate maximum contribution value for each layer
-void determineMaxValue (uint64_t *maxValue, const uint64_t *layerSize)
-{
-  for (int i = 0; i < TABLES_DEPTH; ++i)
-  {
-    uint64_t sum = 0;
-    for (int j = 0; j < i; ++j)
-    {
-      sum += layerSize[j];
-    }
-    maxValue[i] = 1LL << (VIRTUAL_ADDRESS_WIDTH-(OFFSET_WIDTH + sum + 1));
-  }
+/** copies the statistics of the physical memory into stats
+ */
+void VMgetStats(vm_stats* stats){
+  physicalMemory.stats ().snapshot (stats);
 }
 
-// translate virtual address to physical address, find the correct frame and manage page faults
-uint64_t findPhysicalAddress(uint64_t virtualAddress){
-  // Extract page number (remove offset)
-  uint64_t address = extractBits (virtualAddress, OFFSET_WIDTH,
-                                  VIRTUAL_ADDRESS_WIDTH);
-  uint64_t layerSize[TABLES_DEPTH];
-  determineLayerSize(VIRTUAL_ADDRESS_WIDTH-OFFSET_WIDTH, layerSize);
-  uint64_t maxValue[TABLES_DEPTH];
-  determineMaxValue(maxValue, layerSize);
-  word_t curValue;
-  word_t occupied[TABLES_DEPTH] = {0};
-  uint64_t i = 0;
-  for (int layer = 0; layer < TABLES_DEPTH; ++layer)
-  {
-    uint64_t curAddress = determineAddress(layer, layerSize, virtualAddress);
-    PMread (i+curAddress, &curValue);
-    if (curValue == 0){
-      word_t frame = findEmptyFrame(occupied, address, maxValue, layerSize);
-      if (layer < TABLES_DEPTH-1)
-      {
-        // Initialize new page table
-        for (int j = 0; j < PAGE_SIZE; ++j)
-        {
-          PMwrite ((frame * PAGE_SIZE) + j, 0);
-        }
-      }
-      else {
-        // Restore page from disk
-        PMrestore (frame, address);
-      }
-      PMwrite (i+curAddress, frame);
-      curValue = frame;
-    }
-    i = curValue * PAGE_SIZE;
-  }
-  uint64_t offset = extractBits (virtualAddress, 0, OFFSET_WIDTH);
-  return offset + i;
+/** sets every statistic to 0
+ */
+void VMresetStats(){
+  physicalMemory.stats ().reset ();
 }
 
-// check validity of virtual address and pointer
-int checkValidity (uint64_t virtualAddress, const word_t *value)
-{
-  if (virtualAddress >= VIRTUAL_MEMORY_SIZE || value == nullptr){
-    return FAILURE;
-  }
-  return SUCCESS;
+/** reads 'count' words from virtualAddress on into buffer
+ * @return 1 on success and 0 if the range cannot be mapped
+ */
+int VMreadRange(uint64_t virtualAddress, word_t* buffer, uint64_t count){
+  return virtualMemory.readRange (virtualAddress, buffer, count);
 }
 
-// ============================================================================
-// PUBLIC API
-// ============================================================================
+/** writes 'count' words from buffer to virtualAddress on
+ * @return 1 on success and 0 if the range cannot be mapped
+ */
+int VMwriteRange(uint64_t virtualAddress, const word_t* buffer, uint64_t count){
+  return virtualMemory.writeRange (virtualAddress, buffer, count);
+}
 
-/** Initialize the virtual memory by clearing root page table.
- * Must be called before any VMread or VMwrite operations.
+/** copies 'count' words from source to destination, the ranges may overlap
+ * @return 1 on success and 0 if either range cannot be mapped
  */
-void VMinitialize(){
-  for (int i = 0; i < PAGE_SIZE; ++i)
-  {
-    PMwrite (i, 0);
-  }
+int VMcopy(uint64_t destination, uint64_t source, uint64_t count){
+  return virtualMemory.copy (destination, source, count);
 }
 
-/** reads a word from the given virtual address
- * and puts its content in value.
- * @return 1 on success and 0 on failure (if the address cannot be mapped to a physical
- * address for any reason)
+/** writes value to 'count' words from virtualAddress on
+ * @return 1 on success and 0 if the range cannot be mapped
  */
-int VMread(uint64_t virtualAddress, word_t* value){
-  if (checkValidity (virtualAddress, value) == 0){
-    return FAILURE;
-  }
-  const uint64_t physicalAddress = findPhysicalAddress (virtualAddress);
-  PMread (physicalAddress, value);
-  return SUCCESS;
+int VMfill(uint64_t virtualAddress, word_t value, uint64_t count){
+  return virtualMemory.fill (virtualAddress, value, count);
 }
 
-/** writes a word to the given virtual address
- * @return 1 on success and 0 on failure (if the address cannot be mapped to a physical
- * address for any reason)
+/** makes child, an address space on physicalMemory, a copy of the VM*
+ * memory that shares its pages until either side writes them
+ * @return 1 on success and 0 if the memory cannot be forked
  */
-int VMwrite(uint64_t virtualAddress, word_t value){
-  if (checkValidity (virtualAddress, &value) == 0){
-    return FAILURE;
-  }
-  const uint64_t physicalAddress = findPhysicalAddress (virtualAddress);
-  PMwrite(physicalAddress, value);
-  return SUCCESS;
+int VMfork(AddressSpace<DefaultGeometry>* child){
+  return child != nullptr && virtualMemory.fork (*child);
 }
 
+/** writes an image of the VM* memory to path
+ * @return 1 on success and 0 if it could not be written
+ */
+int VMsave(const char* path){
+  return physicalMemory.save (path);
+}
+
+/** takes the VM* memory back from an image written by VMsave
+ * @return 1 on success and 0 if path holds no image of this memory
+ */
+int VMload(const char* path){
+  return physicalMemory.load (path);
+}
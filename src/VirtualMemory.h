@@ -1,18 +1,36 @@
 #pragma once
 
 #include "MemoryConstants.h"
+#include "AddressSpace.h"
 
 /*
  * Initialize the virtual memory
+ *
+ * returns 1 on success.
+ * returns 0 if the RAM could not be allocated, VMread, VMwrite and the
+ * other accesses then fail as before initialization
+ */
+int VMinitialize();
+
+/*
+ * Initialize the virtual memory and choose where evicted pages are kept:
+ * SWAP_MEMORY, SWAP_COMPRESSED, SWAP_PREAD, SWAP_MMAP or SWAP_URING (see
+ * SwapDevice.h). file backends keep the pages in a preallocated file at
+ * swapPath, the others ignore it.
+ *
+ * returns 1 on success.
+ * returns 0 if swapPath is null for a file backend, the swap file could
+ * not be set up or the RAM could not be allocated
  */
-void VMinitialize();
+int VMinitialize(int swapBackend, const char* swapPath);
 
 /* reads a word from the given virtual address
  * and puts its content in *value.
  *
  * returns 1 on success.
  * returns 0 on failure (if the address cannot be mapped to a physical
- * address for any reason)
+ * address for any reason, such as the swap device failing to store the
+ * page evicted for it or to read the page back)
  */
 int VMread(uint64_t virtualAddress, word_t* value);
 
@@ -20,8 +38,151 @@ int VMread(uint64_t virtualAddress, word_t* value);
  *
  * returns 1 on success.
  * returns 0 on failure (if the address cannot be mapped to a physical
- * address for any reason)
+ * address for any reason, the swap device failing included)
  */
 int VMwrite(uint64_t virtualAddress, word_t value);
 
+/* number of translations served from the translation cache
+ * since the last VMinitialize (no page table reads were needed)
+ */
+uint64_t VMtlbHits();
+
+/* number of translations that missed the translation cache
+ * since the last VMinitialize and walked all TABLES_DEPTH levels
+ */
+uint64_t VMtlbMisses();
+
+/* chooses which page is evicted when RAM is full:
+ * POLICY_CYCLIC (the default), POLICY_WEIGHTED, POLICY_LRU, POLICY_CLOCK,
+ * POLICY_LFU or POLICY_ARC (see ReplacementPolicy.h). pages already in RAM
+ * are kept, the new policy starts without history.
+ *
+ * returns 1 on success.
+ * returns 0 if policy is not one of these
+ */
+int VMsetReplacementPolicy(int policy);
+
+/* starts a background thread that keeps between 'low' and 'high' frames
+ * free: whenever faults take the free frames below 'low', it evicts the
+ * pages the replacement policy chooses until 'high' are free, so faults
+ * take a free frame instead of evicting on their own. 0, 0 stops it
+ * (the default). vm_stats counts its evictions in reclaimEvictions.
+ *
+ * returns 1 on success.
+ * returns 0 if built without VM_THREADS, if low > high or if high is
+ * more than half the frames
+ */
+int VMsetReclaimer(uint64_t low, uint64_t high);
+
+/* maps the pages under a missing last-level table with one huge page
+ * from now on if 'enable' is non-zero: one entry of the table above maps
+ * a run of frames, so dense regions take fewer tables and fewer reads per
+ * translation, while every page of the run is faulted in and evicted
+ * together. 0 stops mapping new huge pages (the default).
+ *
+ * returns 1 on success.
+ * returns 0 if built with VM_THREADS, or if the geometry has a single
+ * table level or too few frames for a run
+ */
+int VMsetHugePages(int enable);
+
+/* faults up to 'maxPages' pages in ahead of a sequential or strided
+ * stream of page faults, growing and shrinking the window with how many
+ * prefetched pages get used. 0 turns readahead off (the default).
+ *
+ * returns 1 on success.
+ * returns 0 if built with VM_THREADS, where readahead is not available
+ */
+int VMsetReadahead(uint64_t maxPages);
+
+/* copies the statistics of the memory behind the VM* functions into
+ * 'stats': faults by cause, evictions, where the frames for faults came
+ * from, what faulting translations cost and how long they took (see
+ * Stats.h). counting starts at program start or the last VMresetStats.
+ */
+void VMgetStats(vm_stats* stats);
+
+/* sets every statistic to 0
+ */
+void VMresetStats();
+
+/* reads 'count' consecutive words starting at the given virtual address
+ * into 'buffer'. each page of the range is translated once.
+ *
+ * returns 1 on success.
+ * returns 0 on failure (if any address of the range cannot be mapped,
+ * nothing is read then; if the swap device fails partway, the pages
+ * before the failing one are read)
+ */
+int VMreadRange(uint64_t virtualAddress, word_t* buffer, uint64_t count);
+
+/* writes 'count' consecutive words from 'buffer' starting at the given
+ * virtual address. each page of the range is translated once.
+ *
+ * returns 1 on success.
+ * returns 0 on failure (if any address of the range cannot be mapped,
+ * nothing is written then; if the swap device fails partway, the pages
+ * before the failing one are written)
+ */
+int VMwriteRange(uint64_t virtualAddress, const word_t* buffer, uint64_t count);
+
+/* copies 'count' words from virtual address 'source' to 'destination'.
+ * the ranges may overlap. frames are copied directly, the source page is
+ * kept resident while the destination page is faulted in.
+ *
+ * returns 1 on success.
+ * returns 0 on failure (if any address of either range cannot be mapped)
+ */
+int VMcopy(uint64_t destination, uint64_t source, uint64_t count);
+
+/* writes 'value' to 'count' consecutive words starting at the given
+ * virtual address.
+ *
+ * returns 1 on success.
+ * returns 0 on failure (if any address of the range cannot be mapped)
+ */
+int VMfill(uint64_t virtualAddress, word_t value, uint64_t count);
+
+/* makes 'child', an address space on physicalMemory, a copy of the VM*
+ * memory, as a process fork would: both share every resident and swapped
+ * page, and either side's first write to a page copies it into a frame
+ * of its own, with the tables on its path. forking costs two cleared root
+ * tables, however many pages are resident. if child was initialized, its
+ * pages are dropped first. VMinitialize, or initialize on child, ends the
+ * sharing of that side.
+ *
+ * returns 1 on success.
+ * returns 0 if built with VM_THREADS, if child is nullptr or the VM*
+ * memory itself, or if RAM cannot take two more root tables and still
+ * complete a copy-on-write fault (two walks of TABLES_DEPTH frames)
+ */
+int VMfork(AddressSpace<DefaultGeometry>* child);
+
+/* writes an image of the memory behind the VM* functions to 'path': its
+ * frames, page tables, swapped pages and statistics. the RAM is stored
+ * uncompressed and page-aligned, the swapped pages packed.
+ *
+ * returns 1 on success.
+ * returns 0 if the file could not be written, if the replacement
+ * policy was installed by the caller rather than chosen with
+ * VMsetReplacementPolicy, or while spaces share the pages of a VMfork
+ */
+int VMsave(const char* path);
+
+/* continues from an image written by VMsave, for example a warmed-up
+ * state saved by an earlier run. VMinitialize must have been called. the
+ * RAM is mapped from the file, so loading takes about as long as the
+ * swapped pages take to read, and frames are read in as they are first
+ * touched. the swap backend stays the current one and gets the swapped
+ * pages of the image. the replacement policy is the one saved, without
+ * its history.
+ *
+ * returns 1 on success.
+ * returns 0 if the file could not be read or holds no image of this
+ * geometry, or while spaces share the pages of a VMfork; the memory is
+ * then unchanged
+ */
+int VMload(const char* path);
 
+// the address space behind the VM* functions
+extern AddressSpace<DefaultGeometry> virtualMemory;
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "MemoryConstants.h"
+#include <cassert>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Whole-frame word tests: whether a page is one repeated value and which
+ * entries of a page table are live. With -mavx2 they compare 32 bytes of
+ * words per instruction, otherwise 16 with SSE2 on any x86-64, and one
+ * word at a time elsewhere. Words of 32 and 64 bits (VM_WORD64) both take
+ * the vector paths.
+ */
+
+#define WORD_IS_64 (sizeof(word_t) == sizeof(int64_t))
+
+#if defined(__AVX2__)
+// 'value' in every word of a vector
+static inline __m256i broadcastWord(word_t value) {
+    return WORD_IS_64 ? _mm256_set1_epi64x((int64_t) value)
+                      : _mm256_set1_epi32((int32_t) value);
+}
+#elif defined(__SSE2__)
+static inline __m128i broadcastWord(word_t value) {
+    return WORD_IS_64 ? _mm_set1_epi64x((int64_t) value)
+                      : _mm_set1_epi32((int32_t) value);
+}
+#endif
+
+/*
+ * returns true if each of the 'count' words at 'words' holds 'value'
+ */
+static inline bool allWordsEqual(const word_t* words, uint64_t count,
+                                 word_t value) {
+    uint64_t i = 0;
+#if defined(__AVX2__)
+    // or the differences of 4 vectors before one test
+    const uint64_t lanes = sizeof(__m256i) / sizeof(word_t);
+    const __m256i same = broadcastWord(value);
+    for (; i + 4 * lanes <= count; i += 4 * lanes) {
+        const __m256i* v = reinterpret_cast<const __m256i*>(words + i);
+        const __m256i differ = _mm256_or_si256(
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(v), same),
+                            _mm256_xor_si256(_mm256_loadu_si256(v + 1),
+                                             same)),
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(v + 2),
+                                             same),
+                            _mm256_xor_si256(_mm256_loadu_si256(v + 3),
+                                             same)));
+        if (!_mm256_testz_si256(differ, differ))
+            return false;
+    }
+    for (; i + lanes <= count; i += lanes) {
+        const __m256i differ = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i)),
+            same);
+        if (!_mm256_testz_si256(differ, differ))
+            return false;
+    }
+#elif defined(__SSE2__)
+    // 32-bit compares: a 64-bit word is equal when both its halves are
+    const uint64_t lanes = sizeof(__m128i) / sizeof(word_t);
+    const __m128i same = broadcastWord(value);
+    for (; i + 4 * lanes <= count; i += 4 * lanes) {
+        const __m128i* v = reinterpret_cast<const __m128i*>(words + i);
+        const __m128i equal = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(v), same),
+                          _mm_cmpeq_epi32(_mm_loadu_si128(v + 1), same)),
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(v + 2), same),
+                          _mm_cmpeq_epi32(_mm_loadu_si128(v + 3), same)));
+        if (_mm_movemask_epi8(equal) != 0xffff)
+            return false;
+    }
+    for (; i + lanes <= count; i += lanes) {
+        const __m128i equal = _mm_cmpeq_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i)),
+            same);
+        if (_mm_movemask_epi8(equal) != 0xffff)
+            return false;
+    }
+#endif
+    for (; i < count; i++) {
+        if (words[i] != value)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * returns a mask with bit i set for each word i of the 'count' (at most
+ * 64) words at 'words' that is not 0: the live entries of a table
+ */
+static inline uint64_t nonZeroMask(const word_t* words, uint64_t count) {
+    assert(count <= 64);
+    uint64_t mask = 0;
+    uint64_t i = 0;
+#if defined(__AVX2__)
+    const uint64_t lanes = sizeof(__m256i) / sizeof(word_t);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + lanes <= count; i += lanes) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        // a bit per word, set where it is 0
+        const uint64_t zeros = WORD_IS_64
+            ? _mm256_movemask_pd(_mm256_castsi256_pd(
+                  _mm256_cmpeq_epi64(v, zero)))
+            : _mm256_movemask_ps(_mm256_castsi256_ps(
+                  _mm256_cmpeq_epi32(v, zero)));
+        mask |= (~zeros & ((1ULL << lanes) - 1)) << i;
+    }
+#elif defined(__SSE2__)
+    const uint64_t lanes = sizeof(__m128i) / sizeof(word_t);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + lanes <= count; i += lanes) {
+        uint64_t zeros = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i)),
+            zero)));
+        if (WORD_IS_64) {
+            // a 64-bit word is 0 when both its halves are
+            zeros &= zeros >> 1;
+            zeros = (zeros & 1) | ((zeros >> 1) & 2);
+        }
+        mask |= (~zeros & ((1ULL << lanes) - 1)) << i;
+    }
+#endif
+    for (; i < count; i++) {
+        if (words[i] != 0)
+            mask |= 1ULL << i;
+    }
+    return mask;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cassert>
+
+/*
+ * Helpers shared by the tests: a snapshot of the counters, and words
+ * written and checked by rounds. The word at an address holds
+ * address * seed + round, with the seed chosen by each test.
+ */
+
+template <class G>
+static vm_stats statsOf(PhysicalMemory<G>& memory) {
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    return stats;
+}
+
+static inline word_t valueOf(uint64_t seed, uint64_t address, int round) {
+    return (word_t) (address * seed + round);
+}
+
+// every step-th word gets the value of 'round'
+template <class G>
+static void writeAll(AddressSpace<G>& space, uint64_t seed, int round,
+                     uint64_t step) {
+    for (uint64_t i = 0; i < G::virtualMemorySize; i += step) {
+        int result = space.write(i, valueOf(seed, i, round));
+        assert(result == 1);
+    }
+}
+
+// every step-th word holds the value of 'round', or of 'later' where a
+// later write of every written-th word changed it
+template <class G>
+static void checkAll(AddressSpace<G>& space, uint64_t seed, int round,
+                     uint64_t step, int later = 0, uint64_t written = 0) {
+    for (uint64_t i = 0; i < G::virtualMemorySize; i += step) {
+        word_t value;
+        int result = space.read(i, &value);
+        assert(result == 1);
+        const bool changed = written != 0 && i % written == 0;
+        assert(value == valueOf(seed, i, changed ? later : round));
+    }
+}
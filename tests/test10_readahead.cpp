@@ -0,0 +1,147 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// 64 frames, 4096 pages over 4 tables
+typedef Geometry<3, 9, 15> Scan;
+
+// faults taken by accesses, the prefetched pages left out
+static uint64_t demandFaults(const vm_stats& stats) {
+    return stats.faults - stats.prefetches;
+}
+
+// one word of every 'stride'-th page from 'first' on, checked
+static void scan(AddressSpace<Scan>& space, int64_t first, int64_t stride) {
+    for (int64_t p = first; p >= 0 && p < (int64_t) Scan::numPages;
+         p += stride) {
+        word_t value = 0;
+        int result = space.read(p * Scan::pageSize + 1, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p * 7));
+    }
+}
+
+int main(int argc, char **argv) {
+    PhysicalMemory<Scan> memory;
+    AddressSpace<Scan> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    for (uint64_t p = 0; p < Scan::numPages; ++p) {
+        result = space.write(p * Scan::pageSize + 1, (word_t) (p * 7));
+        assert(result == 1);
+    }
+
+    // without readahead every page of a scan faults
+    memory.stats().reset();
+    scan(space, 0, 1);
+    assert(demandFaults(statsOf(memory)) == Scan::numPages);
+    assert(statsOf(memory).prefetches == 0);
+
+    const int readahead = space.setReadahead(16);
+#ifdef VM_THREADS
+    // readahead is not available with VM_THREADS; the accesses past the
+    // streams run without it
+    assert(readahead == 0);
+#else
+    assert(readahead == 1);
+    const struct { int64_t first, stride; } streams[] = {
+        {0, 1}, {Scan::numPages - 1, -1}, {5, 3}, {Scan::numPages - 2, -7}};
+    for (size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); ++i) {
+        memory.stats().reset();
+        scan(space, streams[i].first, streams[i].stride);
+        const vm_stats stats = statsOf(memory);
+        const int64_t stride = streams[i].stride;
+        const uint64_t pages = Scan::numPages / (stride > 0 ? stride : -stride);
+        // the stream is found after two faults, then kept ahead of
+        assert(demandFaults(stats) < pages / 10);
+        assert(stats.prefetchesUsed > pages * 9 / 10);
+        assert(stats.prefetchesUsed + stats.prefetchesWasted
+               <= stats.prefetches);
+    }
+#endif
+
+    // random pages start no stream
+    memory.stats().reset();
+    uint64_t seed = 3;
+    for (int n = 0; n < 2000; ++n) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t p = (seed >> 33) % Scan::numPages;
+        word_t value = 0;
+        result = space.read(p * Scan::pageSize + 1, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p * 7));
+    }
+    assert(statsOf(memory).prefetches < 20);
+
+    // ranges and copies keep working ahead of and behind the stream
+    std::vector<word_t> buffer(Scan::virtualMemorySize / 4);
+    result = space.readRange(Scan::virtualMemorySize / 2, buffer.data(),
+                             buffer.size());
+    assert(result == 1);
+    for (size_t i = 0; i < buffer.size(); i += Scan::pageSize) {
+        assert(buffer[i + 1]
+               == (word_t) ((Scan::numPages / 2 + i / Scan::pageSize) * 7));
+    }
+    result = space.copy(0, Scan::virtualMemorySize / 2, buffer.size());
+    assert(result == 1);
+    for (uint64_t p = 0; p < Scan::numPages / 4; ++p) {
+        word_t value = 0;
+        result = space.read(p * Scan::pageSize + 1, &value);
+        assert(result == 1);
+        assert(value == (word_t) ((Scan::numPages / 2 + p) * 7));
+    }
+
+#ifndef VM_THREADS
+    // a window larger than RAM can hold wastes prefetches and shrinks
+    PhysicalMemory<Geometry<2, 6, 12> > small;
+    AddressSpace<Geometry<2, 6, 12> > tight(small);
+    result = tight.initialize();
+    assert(result == 1);
+    result = tight.setReadahead(64);
+    assert(result == 1);
+    result = tight.fill(0, 4, Geometry<2, 6, 12>::virtualMemorySize);
+    assert(result == 1);
+    for (uint64_t i = 0; i < Geometry<2, 6, 12>::virtualMemorySize; i += 4) {
+        word_t value = 0;
+        result = tight.read(i, &value);
+        assert(result == 1 && value == 4);
+    }
+    vm_stats tightStats;
+    small.stats().snapshot(&tightStats);
+    assert(tightStats.prefetchesWasted > 0 && tightStats.prefetchesUsed > 0);
+
+    // pages past the copied quarter still hold their values
+    result = space.setReadahead(0);
+    assert(result == 1);
+    memory.stats().reset();
+    scan(space, Scan::numPages / 4, 1);
+    assert(statsOf(memory).prefetches == 0);
+
+    // the VM* functions read ahead once asked to; pages never written
+    // are not worth faulting in ahead
+    VMinitialize();
+    result = VMsetReadahead(8);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE) {
+        result = VMwrite(i, (word_t) i);
+        assert(result == 1);
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+    assert(stats.prefetches == 0);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE) {
+        word_t value = 0;
+        result = VMread(i, &value);
+        assert(result == 1 && value == (word_t) i);
+    }
+    VMgetStats(&stats);
+    assert(stats.prefetchesUsed > NUM_PAGES / 2);
+    result = VMsetReadahead(0);
+    assert(result == 1);
+#endif
+
+    printf("success\n");
+    return 0;
+}
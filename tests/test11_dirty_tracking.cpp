@@ -0,0 +1,102 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <unistd.h>
+
+#define SWAP_PATH "vm_test11.swap"
+
+// 64 frames, 4096 pages over 4 tables
+typedef Geometry<3, 9, 15> Scan;
+
+// one word of every page, checked against what pass 'pass' wrote
+static void readAll(AddressSpace<Scan>& space, uint64_t pass) {
+    for (uint64_t p = 0; p < Scan::numPages; ++p) {
+        word_t value = 0;
+        int result = space.read(p * Scan::pageSize + 3, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p * 5 + (p % 2 == 0 ? pass : 0)));
+    }
+}
+
+// read passes over swapped pages write nothing back, written pages keep
+// their new values, through the given swap backend
+void readMostly(int backend) {
+    PhysicalMemory<Scan> memory;
+    AddressSpace<Scan> space(memory);
+    int result = space.initialize(backend, SWAP_PATH);
+    assert(result == 1);
+    SwapDevice& swap = memory.swapDevice();
+    for (uint64_t p = 0; p < Scan::numPages; ++p) {
+        result = space.write(p * Scan::pageSize + 3, (word_t) (p * 5));
+        assert(result == 1);
+    }
+
+    // the first pass still stores the pages written last; after it
+    // every page is clean
+    readAll(space, 0);
+    memory.stats().reset();
+    const uint64_t written = swap.bytesWritten();
+    readAll(space, 0);
+    readAll(space, 0);
+    vm_stats stats = statsOf(memory);
+    assert(swap.bytesWritten() == written);
+    assert(stats.evictions > 0 && stats.cleanEvictions == stats.evictions);
+
+    // writes and range operations make their pages dirty again
+    memory.stats().reset();
+    for (uint64_t pass = 1; pass <= 2; ++pass) {
+        for (uint64_t p = 0; p < Scan::numPages; p += 2) {
+            const word_t value = (word_t) (p * 5 + pass);
+            if (p % 8 == 0) {
+                result = space.write(p * Scan::pageSize + 3, value);
+                assert(result == 1);
+            } else if (p % 8 == 2) {
+                result = space.writeRange(p * Scan::pageSize + 3, &value, 1);
+                assert(result == 1);
+            } else if (p % 8 == 4) {
+                result = space.fill(p * Scan::pageSize + 3, value, 1);
+                assert(result == 1);
+            } else {
+                // a word of the next page holds the value to copy
+                const uint64_t spare = (p + 1) * Scan::pageSize;
+                result = space.write(spare, value);
+                assert(result == 1);
+                result = space.copy(p * Scan::pageSize + 3, spare, 1);
+                assert(result == 1);
+            }
+        }
+        readAll(space, pass);
+    }
+    stats = statsOf(memory);
+    assert(stats.cleanEvictions > 0 && stats.cleanEvictions < stats.evictions);
+    assert(swap.bytesWritten() > written);
+}
+
+int main(int argc, char **argv) {
+    readMostly(SWAP_MEMORY);
+    readMostly(SWAP_PREAD);
+    readMostly(SWAP_MMAP);
+    readMostly(SWAP_URING);
+    unlink(SWAP_PATH);
+
+    // the VM* functions only store the pages they wrote
+    VMinitialize();
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE) {
+        int result = VMwrite(i, (word_t) i);
+        assert(result == 1);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE) {
+            word_t value = 0;
+            int result = VMread(i, &value);
+            assert(result == 1 && value == (word_t) i);
+        }
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+    assert(stats.cleanEvictions > 0);
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+#include "PageCodec.h"
+#include "SlabArena.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// 64 frames of 64 words, 4096 pages
+typedef Geometry<6, 12, 18> Wide;
+
+// the word 'i' of page 'p' under each of the shapes below
+static word_t wordOf(uint64_t p, uint64_t i) {
+    switch (p % 4) {
+    case 0:
+        return 0;                                    // zeroed
+    case 1:
+        return (word_t) (p * 1000 + i);              // a counter
+    case 2:
+        return (word_t) (i % 3 == 0 ? p : 0);        // sparse small values
+    default: {                                       // noise
+        uint32_t x = (uint32_t) (p * Wide::pageSize + i) * 2654435761u;
+        x ^= x >> 15;
+        x *= 2246822519u;
+        // and in the high bytes of wider words too
+        const uint64_t spread = sizeof(word_t) > 4 ? 0x9E3779B97F4A7C15ULL : 1;
+        return (word_t) ((x ^ (x >> 13)) * spread);
+    }
+    }
+}
+
+// every shape packs and unpacks to itself
+void codec() {
+    word_t page[Wide::pageSize];
+    word_t back[Wide::pageSize];
+    unsigned char packed[sizeof(page)];
+    for (uint64_t p = 0; p < 4; ++p) {
+        for (uint64_t i = 0; i < Wide::pageSize; ++i) page[i] = wordOf(p, i);
+        uint64_t bytes = 0;
+        word_t same = 0;
+        const int kind = packPage(page, Wide::pageSize, packed, &bytes, &same);
+        assert(kind == (p == 0 ? PACK_SAME : p == 3 ? PACK_RAW : PACK_DELTA));
+        assert(kind != PACK_DELTA || bytes < sizeof(page) / 2);
+        unpackPage(kind, packed, bytes, same, back, Wide::pageSize);
+        for (uint64_t i = 0; i < Wide::pageSize; ++i) assert(back[i] == page[i]);
+    }
+    // extreme differences and values that are not all the same
+    const word_t edges[] = {0, -1, INT_MIN, INT_MAX, INT_MIN, 7, 7, 7};
+    for (uint64_t i = 0; i < Wide::pageSize; ++i) page[i] = edges[i % 8];
+    uint64_t bytes = 0;
+    word_t same = 0;
+    const int kind = packPage(page, Wide::pageSize, packed, &bytes, &same);
+    int result = unpackPage(kind, packed, bytes, same, back, Wide::pageSize);
+    assert(result == 1);
+    for (uint64_t i = 0; i < Wide::pageSize; ++i) assert(back[i] == page[i]);
+
+    // bytes that are not one page of their kind are refused
+    result = unpackPage(7, packed, bytes, same, back, Wide::pageSize);
+    assert(result == 0);
+    result = unpackPage(PACK_RAW, packed, bytes - 1, same, back,
+                        Wide::pageSize);
+    assert(result == 0);
+    const unsigned char tooLong[] = {0x01, 0x80, 0x40};
+    result = unpackPage(PACK_DELTA, tooLong, sizeof(tooLong), 0, back,
+                        Wide::pageSize);
+    assert(result == 0);
+    const unsigned char cutShort[] = {0x02, 0x80};
+    result = unpackPage(PACK_DELTA, cutShort, sizeof(cutShort), 0, back,
+                        Wide::pageSize);
+    assert(result == 0);
+}
+
+// objects are carved from slabs and reused once released; an object
+// whose slab cannot be had is refused and costs nothing
+void arena() {
+    SlabArena small(1024);
+    const uint64_t first = small.allocate(100);
+    assert(first != SLAB_NO_OBJECT);
+    assert(small.bytesInUse() >= 100 && small.bytesReserved() > 0);
+    small.release(first);
+    const uint64_t again = small.allocate(97);
+    assert(again == first && small.bytesReserved() == SLAB_BYTES);
+
+    // no system has room for a slab of 2^57 bytes
+    SlabArena huge(1ULL << 62);
+    const uint64_t refused = huge.allocate(1);
+    assert(refused == SLAB_NO_OBJECT);
+    assert(huge.bytesInUse() == 0 && huge.bytesReserved() == 0);
+}
+
+// all pages written through the compressed swap come back, and the
+// regular ones take a fraction of their size
+void swapped() {
+    PhysicalMemory<Wide> memory;
+    AddressSpace<Wide> space(memory);
+    int result = space.initialize(SWAP_COMPRESSED, nullptr);
+    assert(result == 1);
+    std::vector<word_t> page(Wide::pageSize);
+    for (uint64_t p = 0; p < Wide::numPages; ++p) {
+        for (uint64_t i = 0; i < Wide::pageSize; ++i) page[i] = wordOf(p, i);
+        result = space.writeRange(p * Wide::pageSize, page.data(),
+                                  page.size());
+        assert(result == 1);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint64_t p = 0; p < Wide::numPages; ++p) {
+            result = space.readRange(p * Wide::pageSize, page.data(),
+                                     page.size());
+            assert(result == 1);
+            for (uint64_t i = 0; i < Wide::pageSize; ++i) {
+                assert(page[i] == wordOf(p, i));
+            }
+        }
+    }
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    const uint64_t pageBytes = Wide::pageSize * sizeof(word_t);
+    // a quarter of the pages is noise and kept raw, a quarter is free
+    assert(stats.swappedPages == Wide::numPages);
+    assert(stats.swapFootprint < stats.swappedPages * pageBytes / 2);
+    assert(stats.swapFootprint > stats.swappedPages * pageBytes / 4);
+    assert(stats.evictNanoseconds > 0 && stats.restoreNanoseconds > 0);
+
+    // rewritten pages replace their packed copies
+    for (uint64_t p = 0; p < Wide::numPages; p += 4) {
+        result = space.fill(p * Wide::pageSize, (word_t) p, Wide::pageSize);
+        assert(result == 1);
+    }
+    for (uint64_t p = 0; p < Wide::numPages; ++p) {
+        word_t value = 0;
+        result = space.read(p * Wide::pageSize + 5, &value);
+        assert(result == 1);
+        assert(value == (p % 4 == 0 ? (word_t) p : wordOf(p, 5)));
+    }
+    memory.stats().snapshot(&stats);
+    assert(stats.swappedPages == Wide::numPages);
+
+    // a second space shares the swap until it detaches
+    {
+        AddressSpace<Wide> other(memory);
+        result = other.initialize();
+        assert(result == 1);
+        for (uint64_t p = 0; p < Wide::numPages; ++p) {
+            result = other.write(p * Wide::pageSize, (word_t) p);
+            assert(result == 1);
+        }
+        memory.stats().snapshot(&stats);
+        assert(stats.swappedPages > Wide::numPages);
+    }
+    memory.stats().snapshot(&stats);
+    assert(stats.swappedPages <= Wide::numPages);
+
+    result = space.initialize(SWAP_MEMORY, nullptr);
+    assert(result == 1);
+    memory.stats().snapshot(&stats);
+    assert(stats.swappedPages == 0 && stats.swapFootprint == 0);
+}
+
+int main(int argc, char **argv) {
+    codec();
+    arena();
+    swapped();
+
+    // the VM* functions over the compressed swap
+    int result = VMinitialize(SWAP_COMPRESSED, nullptr);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; ++i) {
+        VMwrite(i, (word_t) (i / 3));
+    }
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; ++i) {
+        word_t value;
+        VMread(i, &value);
+        assert(value == (word_t) (i / 3));
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+    assert(stats.swapFootprint < stats.swappedPages * PAGE_SIZE
+                                 * sizeof(word_t));
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// one table level: 15 frames for pages, 16 pages
+typedef Geometry<4, 8, 8> Flat;
+// three table levels, 7 frames besides the root
+typedef Geometry<2, 5, 8> Deep;
+
+// reads of never-written pages see zeros and take no frame
+void flat() {
+    PhysicalMemory<Flat> memory;
+    AddressSpace<Flat> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    for (uint64_t i = 0; i < Flat::virtualMemorySize; ++i) {
+        word_t value = 1;
+        result = space.read(i, &value);
+        assert(result == 1 && value == 0);
+    }
+    vm_stats stats = statsOf(memory);
+    assert(stats.faults == 0 && stats.evictions == 0);
+    assert(stats.zeroReads == Flat::virtualMemorySize);
+    // the zero frame is cached: one walk per page
+    assert(space.tlbMissCount() == Flat::numPages);
+
+    // 15 written pages fill the RAM; reading the 16th evicts none of them
+    for (uint64_t p = 0; p < 15; ++p) {
+        result = space.write(p * Flat::pageSize + 1, (word_t) (p + 1));
+        assert(result == 1);
+    }
+    std::vector<word_t> page(Flat::pageSize, 1);
+    result = space.readRange(15 * Flat::pageSize, page.data(), page.size());
+    assert(result == 1);
+    for (uint64_t i = 0; i < page.size(); ++i) assert(page[i] == 0);
+    stats = statsOf(memory);
+    assert(stats.faults == 15 && stats.firstTouchFaults == 15);
+    assert(stats.evictions == 0);
+
+    // a first write copies the zero frame: the rest of the page reads 0
+    word_t value = 1;
+    result = space.read(7 * Flat::pageSize, &value);
+    assert(result == 1 && value == 0);
+    result = space.read(7 * Flat::pageSize + 1, &value);
+    assert(result == 1 && value == 8);
+
+    // the 16th page gets a frame of its own once written, even after its
+    // reads were cached
+    result = space.write(15 * Flat::pageSize + 2, 99);
+    assert(result == 1);
+    result = space.read(15 * Flat::pageSize + 2, &value);
+    assert(result == 1 && value == 99);
+    result = space.read(15 * Flat::pageSize + 3, &value);
+    assert(result == 1 && value == 0);
+    assert(statsOf(memory).evictions == 1);
+
+    // copies out of a never-written page write zeros
+    PhysicalMemory<Flat> other;
+    AddressSpace<Flat> copies(other);
+    result = copies.initialize();
+    assert(result == 1);
+    result = copies.fill(0, 5, Flat::pageSize);
+    assert(result == 1);
+    result = copies.copy(2, Flat::pageSize, 4);
+    assert(result == 1);
+    for (uint64_t i = 0; i < Flat::pageSize; ++i) {
+        result = copies.read(i, &value);
+        assert(result == 1);
+        assert(value == (i >= 2 && i < 6 ? 0 : 5));
+    }
+}
+
+// missing tables are not created for reads either
+void deep() {
+    PhysicalMemory<Deep> memory;
+    AddressSpace<Deep> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    for (uint64_t p = 0; p < Deep::numPages; p += 5) {
+        word_t value = 1;
+        result = space.read(p * Deep::pageSize, &value);
+        assert(result == 1 && value == 0);
+    }
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.tableFaults == 0 && stats.faults == 0);
+
+    // once swapped out, a page is read back from swap, not from zeros
+    for (uint64_t p = 0; p < Deep::numPages; ++p) {
+        result = space.write(p * Deep::pageSize, (word_t) (p + 1));
+        assert(result == 1);
+    }
+    for (uint64_t p = 0; p < Deep::numPages; ++p) {
+        word_t value = 0;
+        result = space.read(p * Deep::pageSize, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p + 1));
+    }
+}
+
+int main(int argc, char **argv) {
+    flat();
+    deep();
+
+    // a sparse read-mostly pass over the VM* memory keeps the written
+    // pages resident
+    VMinitialize();
+    for (uint64_t p = 0; p < NUM_FRAMES / 2; ++p) {
+        int result = VMwrite(p * PAGE_SIZE, (word_t) p);
+        assert(result == 1);
+    }
+    VMresetStats();
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE / 2) {
+        word_t value = 1;
+        int result = VMread(i, &value);
+        assert(result == 1);
+        assert(value == (i % PAGE_SIZE == 0 && i / PAGE_SIZE < NUM_FRAMES / 2
+                         ? (word_t) (i / PAGE_SIZE) : 0));
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+    assert(stats.faults == 0 && stats.evictions == 0 && stats.zeroReads > 0);
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// three table levels of 4 entries: 64 frames, 64 pages, huge pages of 4
+typedef Geometry<2, 8, 8> Small;
+// one table level, nothing to map with a huge page
+typedef Geometry<4, 8, 8> Flat;
+
+// the word at an address holds address * SEED + round
+#define SEED 7
+
+// what turning huge pages on or off returns: with VM_THREADS they are not
+// available and the same accesses run without them
+#ifdef VM_THREADS
+#define HUGE_SET 0
+#else
+#define HUGE_SET 1
+#endif
+
+// half the pages written and read back, with and without huge pages
+static vm_stats dense(bool huge) {
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setHugePages(huge);
+    assert(result == HUGE_SET);
+    const uint64_t words = Small::virtualMemorySize / 2;
+    for (uint64_t i = 0; i < words; ++i) {
+        result = space.write(i, valueOf(SEED, i, 0));
+        assert(result == 1);
+    }
+    for (uint64_t i = 0; i < words; ++i) {
+        word_t value;
+        result = space.read(i, &value);
+        assert(result == 1 && value == valueOf(SEED, i, 0));
+    }
+    vm_stats stats = statsOf(memory);
+    assert(stats.evictions == 0);
+    return stats;
+}
+
+// every page under eviction pressure, by every policy, through reads,
+// writes, range copies and huge pages turned off and on again
+static void pressure(int policy) {
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setPolicy(policy);
+    assert(result == 1);
+    result = memory.frameTable().setHugePages(true);
+    assert(result == HUGE_SET);
+    const uint64_t size = Small::virtualMemorySize;
+    for (int round = 0; round < 3; ++round) {
+        memory.frameTable().setHugePages(round != 1);
+        writeAll(space, SEED, round, 1);
+        uint64_t state = 12345;
+        for (uint64_t n = 0; n < 2 * size; ++n) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            const uint64_t i = (state >> 33) % size;
+            word_t value;
+            result = space.read(i, &value);
+            assert(result == 1);
+            assert(value == valueOf(SEED, i, round));
+        }
+        checkAll(space, SEED, round, 5);
+    }
+    // copies between pages of different huge pages
+    result = space.copy(size - 3 * Small::pageSize, 1, 2 * Small::pageSize);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; ++i) {
+        word_t value;
+        result = space.read(i, &value);
+        assert(result == 1);
+        const uint64_t from = size - 3 * Small::pageSize;
+        const bool copied = i >= from && i < size - Small::pageSize;
+        assert(value == valueOf(SEED, copied ? i - from + 1 : i, 2));
+    }
+    vm_stats stats = statsOf(memory);
+    assert(stats.evictions > 0);
+#ifndef VM_THREADS
+    assert(stats.hugeFaults > 0);
+#endif
+}
+
+// huge pages of two spaces compete for the runs; one detaching leaves
+// the other's pages intact
+static void spaces() {
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> first(memory);
+    int result = first.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setHugePages(true);
+    assert(result == HUGE_SET);
+    const uint64_t size = Small::virtualMemorySize;
+    {
+        AddressSpace<Small> second(memory);
+        result = second.initialize();
+        assert(result == 1);
+        for (uint64_t i = 0; i < size; ++i) {
+            result = first.write(i, valueOf(SEED, i, 0));
+            assert(result == 1);
+            result = second.write(size - 1 - i, valueOf(SEED, i, 1));
+            assert(result == 1);
+        }
+        for (uint64_t i = 0; i < size; ++i) {
+            word_t value;
+            result = second.read(size - 1 - i, &value);
+            assert(result == 1);
+            assert(value == valueOf(SEED, i, 1));
+        }
+    }
+    for (uint64_t i = 0; i < size; ++i) {
+        word_t value;
+        result = first.read(i, &value);
+        assert(result == 1 && value == valueOf(SEED, i, 0));
+    }
+    // a cleared space starts over with zeros
+    result = first.initialize();
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; i += 3) {
+        word_t value = 1;
+        result = first.read(i, &value);
+        assert(result == 1);
+    }
+}
+
+int main(int argc, char **argv) {
+    // a huge page takes the place of a last-level table, so the same
+    // accesses fault in fewer tables and read fewer entries
+    const vm_stats tables = dense(false);
+    const vm_stats huge = dense(true);
+    assert(tables.hugeFaults == 0);
+#ifdef VM_THREADS
+    assert(huge.hugeFaults == 0);
+#else
+    assert(huge.hugeFaults == Small::numPages / 2 / 4);
+    assert(huge.tableFaults < tables.tableFaults);
+    assert(huge.faultTablesVisited < tables.faultTablesVisited);
+    assert(huge.pmReads < tables.pmReads);
+#endif
+
+    for (int policy = 0; policy < POLICY_COUNT; ++policy) {
+        pressure(policy);
+    }
+    spaces();
+
+    PhysicalMemory<Flat> flat;
+    int result = flat.frameTable().setHugePages(true);
+    assert(result == 0);
+
+    // the VM* functions with huge pages
+    VMinitialize();
+    result = VMsetHugePages(1);
+    assert(result == HUGE_SET);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 3) {
+        VMwrite(i, (word_t) (i / 3));
+    }
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 3) {
+        word_t value;
+        VMread(i, &value);
+        assert(value == (word_t) (i / 3));
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+#ifndef VM_THREADS
+    assert(stats.hugeFaults > 0);
+#endif
+    result = VMsetHugePages(0);
+    assert(result == HUGE_SET);
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <thread>
+
+// 64 frames of 16 words, 4096 pages over 3 tables
+typedef Geometry<4, 10, 16> Small;
+
+#define WORKERS 4
+#define ROUNDS 4
+
+// each worker writes and checks every page of a space of its own, so
+// there is always more to fault in than fits
+void work(AddressSpace<Small>* space, int id) {
+    const uint64_t pages = Small::numPages;
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (uint64_t p = 0; p < pages; p += 3) {
+            int result = space->write(p * Small::pageSize + round,
+                                      (word_t) (p * 10 + id + round));
+            assert(result == 1);
+        }
+        for (uint64_t p = 0; p < pages; p += 3) {
+            word_t value = 0;
+            int result = space->read(p * Small::pageSize + round, &value);
+            assert(result == 1);
+            assert(value == (word_t) (p * 10 + id + round));
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    PhysicalMemory<Small> memory;
+    FrameTable<Small>& frames = memory.frameTable();
+    std::vector<AddressSpace<Small>*> spaces;
+    for (int w = 0; w < WORKERS; ++w) {
+        spaces.push_back(new AddressSpace<Small>(memory));
+        int result = spaces[w]->initialize();
+        assert(result == 1);
+    }
+
+#ifdef VM_THREADS
+    int result = frames.setReclaimer(8, 4);
+    assert(result == 0);
+    result = frames.setReclaimer(4, Small::numFrames);
+    assert(result == 0);
+    result = frames.setReclaimer(4, 12);
+    assert(result == 1);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < WORKERS; ++w) {
+        workers.push_back(std::thread(work, spaces[w], w));
+    }
+    for (int w = 0; w < WORKERS; ++w) workers[w].join();
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.reclaimEvictions > 0);
+    assert(stats.reclaimEvictions <= stats.evictions);
+
+    // the reclaimer keeps running through a policy change, a space
+    // detaching and another one attaching
+    result = frames.setPolicy(POLICY_LRU);
+    assert(result == 1);
+    delete spaces[WORKERS - 1];
+    spaces[WORKERS - 1] = new AddressSpace<Small>(memory);
+    result = spaces[WORKERS - 1]->initialize();
+    assert(result == 1);
+    work(spaces[WORKERS - 1], WORKERS - 1);
+    work(spaces[0], 0);
+    result = frames.setReclaimer(0, 0);
+    assert(result == 1);
+    work(spaces[1], 1);
+#else
+    // without threads there is nothing to reclaim in the background
+    int result = frames.setReclaimer(4, 12);
+    assert(result == 0);
+    for (int w = 0; w < WORKERS; ++w) work(spaces[w], w);
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.reclaimEvictions == 0);
+#endif
+    for (int w = 0; w < WORKERS; ++w) delete spaces[w];
+
+    printf("success\n");
+    return 0;
+}
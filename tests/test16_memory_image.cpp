@@ -0,0 +1,192 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <unistd.h>
+
+#define IMAGE_PATH "vm_test16.image"
+
+// 64 frames of 64 words, a RAM the image can be mapped from
+typedef Geometry<6, 12, 18> Wide;
+// 64 frames of 4 words, a RAM too small to map, copied instead
+typedef Geometry<2, 8, 8> Small;
+
+// the word at an address holds address * SEED + round
+#define SEED 3
+
+// a memory saved under eviction pressure comes back the same, counters
+// included, in the same memory and in a fresh one on another backend
+template <class G>
+static void roundTrip(uint64_t step, bool huge) {
+    PhysicalMemory<G> memory;
+    AddressSpace<G> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setPolicy(POLICY_LRU);
+    assert(result == 1);
+    // huge pages are not available with VM_THREADS
+    huge = huge && memory.frameTable().setHugePages(true) == 1;
+    writeAll(space, SEED, 1, step);
+    checkAll(space, SEED, 1, step * 5);
+    vm_stats saved;
+    memory.stats().snapshot(&saved);
+    assert(saved.evictions > 0 && saved.swappedPages > 0);
+    result = memory.save(IMAGE_PATH);
+    assert(result == 1);
+
+    writeAll(space, SEED, 2, step);
+    result = memory.load(IMAGE_PATH);
+    assert(result == 1);
+    vm_stats loaded;
+    memory.stats().snapshot(&loaded);
+    assert(loaded.faults == saved.faults);
+    assert(loaded.evictions == saved.evictions);
+    assert(loaded.swappedPages == saved.swappedPages);
+    assert(memory.frameTable().policyOf() == POLICY_LRU);
+    assert(memory.frameTable().hugePages() == huge);
+    checkAll(space, SEED, 1, step);
+    writeAll(space, SEED, 3, step);
+    checkAll(space, SEED, 3, step);
+
+    PhysicalMemory<G> other;
+    AddressSpace<G> copy(other);
+    result = copy.initialize(SWAP_COMPRESSED, nullptr);
+    assert(result == 1);
+    result = other.load(IMAGE_PATH);
+    assert(result == 1);
+    checkAll(copy, SEED, 1, step);
+
+    // the image needs the spaces it was saved with
+    PhysicalMemory<G> crowded;
+    AddressSpace<G> first(crowded);
+    AddressSpace<G> second(crowded);
+    result = first.initialize();
+    assert(result == 1);
+    result = second.initialize();
+    assert(result == 1);
+    result = first.write(0, 77);
+    assert(result == 1);
+    result = crowded.load(IMAGE_PATH);
+    assert(result == 0);
+    word_t value;
+    result = first.read(0, &value);
+    assert(result == 1 && value == 77);
+}
+
+// reads or overwrites 'size' bytes of the image at 'offset'
+static void readImage(uint64_t offset, void* bytes, size_t size) {
+    FILE* file = fopen(IMAGE_PATH, "rb");
+    assert(file != nullptr);
+    int result = fseek(file, (long) offset, SEEK_SET);
+    assert(result == 0);
+    result = (int) fread(bytes, size, 1, file);
+    assert(result == 1);
+    fclose(file);
+}
+
+static void patchImage(uint64_t offset, const void* bytes, size_t size) {
+    FILE* file = fopen(IMAGE_PATH, "r+b");
+    assert(file != nullptr);
+    int result = fseek(file, (long) offset, SEEK_SET);
+    assert(result == 0);
+    result = (int) fwrite(bytes, size, 1, file);
+    assert(result == 1);
+    fclose(file);
+}
+
+// an image with a damaged frame, root or swapped page is refused before
+// anything of the memory changes
+static void damaged() {
+    PhysicalMemory<Wide> memory;
+    AddressSpace<Wide> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    writeAll(space, SEED, 1, 7);
+    result = memory.save(IMAGE_PATH);
+    assert(result == 1);
+    image_header header;
+    readImage(0, &header, sizeof(header));
+    assert(header.swapPages > 0);
+    const uint64_t info = sizeof(image_header);
+    const uint64_t roots = info + Wide::numFrames * sizeof(frame_info);
+    const uint64_t pages = header.ramOffset + Wide::ramSize * sizeof(word_t);
+
+    for (int damage = 0; damage < 5; ++damage) {
+        result = memory.save(IMAGE_PATH);
+        assert(result == 1);
+        const uint64_t swapped = statsOf(memory).swappedPages;
+        frame_info frame;
+        readImage(info + 5 * sizeof(frame_info), &frame, sizeof(frame));
+        image_page record;
+        readImage(pages, &record, sizeof(record));
+        if (damage == 0) {
+            // a run of 8194 equal words, past the end of the page
+            const unsigned char run[] = {0x01, 0x80, 0x40};
+            record.kind = PACK_DELTA;
+            record.bytes = sizeof(run);
+            patchImage(pages, &record, sizeof(record));
+            patchImage(pages + sizeof(record), run, sizeof(run));
+        } else if (damage == 1) {
+            record.kind = 7;
+            patchImage(pages, &record, sizeof(record));
+        } else if (damage == 2) {
+            frame.role = 9;
+            patchImage(info + 5 * sizeof(frame_info), &frame, sizeof(frame));
+        } else if (damage == 3) {
+            frame.role = FRAME_PAGE;
+            frame.parentTable = (word_t) Wide::numFrames;
+            patchImage(info + 5 * sizeof(frame_info), &frame, sizeof(frame));
+        } else {
+            const int64_t root = Wide::numFrames;
+            patchImage(roots, &root, sizeof(root));
+        }
+        result = memory.load(IMAGE_PATH);
+        assert(result == 0);
+        assert(statsOf(memory).swappedPages == swapped);
+        checkAll(space, SEED, 1, 7);
+    }
+}
+
+int main(int argc, char **argv) {
+    roundTrip<Wide>(7, false);
+    roundTrip<Small>(1, false);
+    roundTrip<Small>(1, true);
+    damaged();
+
+    // nothing is taken from files that are missing or hold no image of
+    // the geometry
+    PhysicalMemory<Wide> wide;
+    AddressSpace<Wide> space(wide);
+    int result = space.initialize();
+    assert(result == 1);
+    result = wide.load(IMAGE_PATH);
+    assert(result == 0);
+    result = wide.load("vm_test16.missing");
+    assert(result == 0);
+    FILE* file = fopen(IMAGE_PATH, "wb");
+    fputs("not an image", file);
+    fclose(file);
+    result = wide.load(IMAGE_PATH);
+    assert(result == 0);
+
+    // the VM* functions from a saved warm state
+    VMinitialize();
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 5) {
+        VMwrite(i, (word_t) i);
+    }
+    result = VMsave(IMAGE_PATH);
+    assert(result == 1);
+    VMinitialize();
+    result = VMload(IMAGE_PATH);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 5) {
+        word_t value;
+        VMread(i, &value);
+        assert(value == (word_t) i);
+    }
+    unlink(IMAGE_PATH);
+
+    printf("success\n");
+    return 0;
+}
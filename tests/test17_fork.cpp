@@ -0,0 +1,202 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+#define IMAGE_PATH "vm_test17.image"
+
+// 64 frames of 16 words, 4096 pages over 3 tables
+typedef Geometry<4, 10, 16> Small;
+// 64 frames of 4 words, 1024 pages over 5 tables
+typedef Geometry<2, 8, 12> Deep;
+// 8 frames: no room for two more roots and two walks of 3 tables
+typedef Geometry<2, 5, 8> Tiny;
+
+// the word at an address holds address * SEED + round
+#define SEED 5
+
+// what the child of diverge holds at an address before its range writes
+static word_t childWord(uint64_t address) {
+    if (address % 3 != 0) {
+        return 0;
+    }
+    return valueOf(SEED, address, address % 6 == 0 ? 2 : 1);
+}
+
+// both sides keep their own view under eviction pressure, by every
+// policy, and forking costs the same with few or many pages resident
+template <class G>
+static void diverge(int policy) {
+    PhysicalMemory<G> memory;
+    AddressSpace<G> parent(memory);
+    int result = parent.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setPolicy(policy);
+    assert(result == 1);
+    writeAll(parent, SEED, 1, 3);
+
+    AddressSpace<G> child(memory);
+    const vm_stats before = statsOf(memory);
+    result = parent.fork(child);
+    assert(result == 1);
+    const vm_stats after = statsOf(memory);
+    assert(after.pmWrites - before.pmWrites <= 2 * (G::pageSize + 1));
+    assert(after.faults == before.faults);
+
+    checkAll(child, SEED, 1, 3);
+    writeAll(child, SEED, 2, 6);
+    checkAll(parent, SEED, 1, 3);
+    writeAll(parent, SEED, 3, 9);
+    checkAll(child, SEED, 1, 3, 2, 6);
+    checkAll(parent, SEED, 1, 3, 3, 9);
+    assert(statsOf(memory).copyFaults > 0);
+
+    // range operations copy on write as well
+    const uint64_t count = 3 * G::pageSize;
+    const uint64_t end = G::virtualMemorySize - count;
+    std::vector<word_t> buffer(count);
+    result = child.readRange(G::pageSize / 2, buffer.data(), count);
+    assert(result == 1);
+    result = parent.writeRange(1, buffer.data(), count);
+    assert(result == 1);
+    result = child.copy(end, G::pageSize, count);
+    assert(result == 1);
+    result = child.fill(0, 9, 2);
+    assert(result == 1);
+    for (uint64_t i = 0; i < count; ++i) {
+        const uint64_t read = G::pageSize / 2 + i;
+        const uint64_t copied = G::pageSize + i;
+        assert(buffer[i] == childWord(read));
+        word_t value;
+        result = parent.read(1 + i, &value);
+        assert(result == 1 && value == buffer[i]);
+        result = child.read(end + i, &value);
+        assert(result == 1);
+        assert(value == childWord(copied));
+    }
+    word_t value;
+    result = child.read(1, &value);
+    assert(result == 1 && value == 9);
+    result = parent.read(0, &value);
+    assert(result == 1 && value == valueOf(SEED, 0, 3));
+}
+
+// forks of forks, torn down in any order, leave the survivors' pages
+// intact and give every frame back
+template <class G>
+static void generations() {
+    PhysicalMemory<G> memory;
+    AddressSpace<G> parent(memory);
+    int result = parent.initialize();
+    assert(result == 1);
+    writeAll(parent, SEED, 1, 2);
+    for (int round = 0; round < 20; ++round) {
+        AddressSpace<G>* child = new AddressSpace<G>(memory);
+        AddressSpace<G>* grandchild = new AddressSpace<G>(memory);
+        result = parent.fork(*child);
+        assert(result == 1);
+        result = child->fork(*grandchild);
+        assert(result == 1);
+        writeAll(*grandchild, SEED, 2, 4);
+        writeAll(*child, SEED, 3, 8);
+        checkAll(*grandchild, SEED, 1, 2, 2, 4);
+        checkAll(*child, SEED, 1, 2, 3, 8);
+        checkAll(parent, SEED, 1, 2);
+        if (round % 2 == 0) {
+            delete child;
+            checkAll(*grandchild, SEED, 1, 2, 2, 4);
+            delete grandchild;
+        } else {
+            delete grandchild;
+            // a child forked again drops what it had
+            result = parent.fork(*child);
+            assert(result == 1);
+            checkAll(*child, SEED, 1, 2);
+            delete child;
+        }
+    }
+    checkAll(parent, SEED, 1, 2);
+
+    // initialize ends the sharing of one side only; once nothing is
+    // shared the memory can be saved again
+    AddressSpace<G> child(memory);
+    result = parent.fork(child);
+    assert(result == 1);
+    result = parent.initialize();
+    assert(result == 1);
+    for (uint64_t i = 0; i < G::virtualMemorySize; i += 7) {
+        word_t value;
+        result = parent.read(i, &value);
+        assert(result == 1 && value == 0);
+    }
+    checkAll(child, SEED, 1, 2);
+    result = memory.save(IMAGE_PATH);
+    assert(result == 0);
+    result = child.initialize();
+    assert(result == 1);
+    result = memory.save(IMAGE_PATH);
+    assert(result == 1);
+    remove(IMAGE_PATH);
+}
+
+int main(int argc, char **argv) {
+#ifdef VM_THREADS
+    // forks need a memory used by one thread
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> parent(memory);
+    AddressSpace<Small> child(memory);
+    int result = parent.initialize();
+    assert(result == 1);
+    result = parent.fork(child);
+    assert(result == 0);
+#else
+    for (int policy = 0; policy < POLICY_COUNT; ++policy) {
+        diverge<Small>(policy);
+    }
+    diverge<Deep>(POLICY_CYCLIC);
+    generations<Small>();
+    generations<Deep>();
+
+    // a memory too small for forks, and spaces that cannot be forked
+    PhysicalMemory<Tiny> tiny;
+    AddressSpace<Tiny> parent(tiny);
+    AddressSpace<Tiny> child(tiny);
+    int result = parent.fork(child);
+    assert(result == 0);
+    result = parent.initialize();
+    assert(result == 1);
+    result = parent.fork(child);
+    assert(result == 0);
+    result = parent.fork(parent);
+    assert(result == 0);
+    PhysicalMemory<Tiny> other;
+    AddressSpace<Tiny> elsewhere(other);
+    result = parent.fork(elsewhere);
+    assert(result == 0);
+
+    // the VM* memory forked into a space of its own
+    VMinitialize();
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 7) {
+        VMwrite(i, (word_t) i);
+    }
+    AddressSpace<DefaultGeometry> forked(physicalMemory);
+    result = VMfork(nullptr);
+    assert(result == 0);
+    result = VMfork(&forked);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 14) {
+        VMwrite(i, (word_t) (i + 1));
+    }
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += 7) {
+        word_t value;
+        result = forked.read(i, &value);
+        assert(result == 1 && value == (word_t) i);
+        VMread(i, &value);
+        assert(value == (word_t) (i % 14 == 0 ? i + 1 : i));
+    }
+#endif
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+#include "PageCodec.h"
+#include "WordScan.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// 64 frames of 256 words, 65536 pages over 2 wide tables
+typedef Geometry<8, 14, 24> Wide;
+
+// the vector and plain paths agree on every length and every position
+// of the one word that differs
+static void scans() {
+    std::vector<word_t> words(160);
+    for (uint64_t count = 0; count <= words.size(); ++count) {
+        for (uint64_t odd = 0; odd <= count; ++odd) {
+            for (uint64_t i = 0; i < words.size(); ++i) {
+                words[i] = 0;
+            }
+            if (odd < count) {
+                words[odd] = (word_t) (odd % 2 == 0 ? -1 : odd + 1);
+            }
+            assert(allWordsEqual(words.data(), count, 0) == (odd == count));
+            if (count > 64) {
+                continue;
+            }
+            const uint64_t mask = nonZeroMask(words.data(), count);
+            assert(mask == (odd < count ? 1ULL << odd : 0));
+        }
+    }
+
+    // a mask of every other word, in and past the vectors
+    for (uint64_t i = 0; i < 64; ++i) {
+        words[i] = (word_t) (i % 2);
+    }
+    assert(nonZeroMask(words.data(), 64) == 0xaaaaaaaaaaaaaaaaULL);
+    assert(nonZeroMask(words.data(), 7) == 0x2aULL);
+    assert(nonZeroMask(words.data() + 1, 3) == 0x5ULL);
+}
+
+// pages of one repeated value are kept as that value, and one word of
+// another value anywhere makes a page of more than one
+static void uniformPages() {
+    std::vector<word_t> page(Wide::pageSize, 7);
+    std::vector<unsigned char> packed(Wide::pageSize * sizeof(word_t));
+    uint64_t bytes;
+    word_t same = 0;
+    int result = packPage(page.data(), page.size(), packed.data(), &bytes,
+                          &same);
+    assert(result == PACK_SAME);
+    assert(same == 7);
+    for (uint64_t i = 0; i < page.size(); i += 37) {
+        page[i] = 8;
+        const int kind = packPage(page.data(), page.size(), packed.data(),
+                                  &bytes, &same);
+        assert(kind != PACK_SAME);
+        std::vector<word_t> unpacked(page.size());
+        unpackPage(kind, packed.data(), bytes, same, unpacked.data(),
+                   unpacked.size());
+        assert(unpacked == page);
+        page[i] = 7;
+    }
+}
+
+// wide tables are cleared in one go, still counted word by word, and
+// read back under eviction pressure
+static void wideTables() {
+    PhysicalMemory<Wide> memory;
+    AddressSpace<Wide> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    memory.stats().reset();
+    result = space.write(0, 1);
+    assert(result == 1);
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.tableFaults == 1);
+#ifndef VM_THREADS
+    // one table cleared, two entries and the word written; the word
+    // counters are not kept with VM_THREADS
+    assert(stats.pmWrites == Wide::pageSize + 3);
+#endif
+
+    const uint64_t step = Wide::pageSize * 97 + 5;
+    for (uint64_t i = 0; i < Wide::virtualMemorySize; i += step) {
+        result = space.write(i, (word_t) (i / step + 1));
+        assert(result == 1);
+    }
+    for (uint64_t i = 0; i < Wide::virtualMemorySize; i += step) {
+        word_t value;
+        result = space.read(i, &value);
+        assert(result == 1 && value == (word_t) (i / step + 1));
+    }
+    memory.stats().snapshot(&stats);
+    assert(stats.evictions > 0 && stats.tableFaults > 1);
+}
+
+int main(int argc, char **argv) {
+    scans();
+    uniformPages();
+    wideTables();
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// 2^18 frames of 4096 words, 48-bit virtual addresses over 3 tables: a
+// 4 GiB RAM (16 GiB with VM_WORD64) that is only committed where used
+typedef Geometry<12, 30, 48> Wide;
+// 256 frames of 256 words, 63-bit virtual addresses over 7 tables
+typedef Geometry<8, 16, 63> Tall;
+
+// addresses spread over the whole virtual memory, the last one included
+template <class G>
+static uint64_t addressOf(uint64_t i, uint64_t count) {
+    if (i == count - 1) {
+        return G::virtualMemorySize - 1;
+    }
+    return (i * 0x9E3779B97F4A7C15ULL) >> (64 - G::virtualAddressWidth);
+}
+
+// bytes of a page-aligned mapping the system has committed
+static uint64_t residentBytes(const void* start, uint64_t bytes) {
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((bytes + page - 1) / page);
+    int result = mincore(const_cast<void*>(start), bytes, resident.data());
+    assert(result == 0);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < resident.size(); ++i) {
+        count += resident[i] & 1;
+    }
+    return count * page;
+}
+
+// the most the RAM may commit for 'bytes' bytes of frames handed out from
+// the bottom: with PM_HUGEPAGES whole huge pages, and one more for the
+// zero frame past the end
+static uint64_t ramBytes(uint64_t bytes) {
+#ifdef PM_HUGEPAGES
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE
+           + 2 * HUGE_PAGE_SIZE;
+#else
+    return bytes;
+#endif
+}
+
+// every address translates through each layer to its own word, and the
+// words past the virtual memory are refused
+template <class G>
+static void spread(uint64_t count) {
+    PhysicalMemory<G> memory;
+    AddressSpace<G> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    for (uint64_t i = 0; i < count; ++i) {
+        result = space.write(addressOf<G>(i, count), valueOf(7, i, 1));
+        assert(result == 1);
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        word_t value;
+        result = space.read(addressOf<G>(i, count), &value);
+        assert(result == 1);
+        assert(value == valueOf(7, i, 1));
+        // the neighbour word was never written
+        const uint64_t other = addressOf<G>(i, count) ^ 1;
+        result = space.read(other, &value);
+        assert(result == 1 && value == 0);
+    }
+    word_t value;
+    result = space.read(G::virtualMemorySize, &value);
+    assert(result == 0);
+    result = space.write(G::virtualMemorySize, 1);
+    assert(result == 0);
+    result = space.read(~0ULL, &value);
+    assert(result == 0);
+
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    // the RAM in use is the frames handed out, not the RAM size
+    const uint64_t frameBytes = G::pageSize * sizeof(word_t);
+    const uint64_t used = stats.freeFrameAllocations + 2;
+    assert(residentBytes(memory.data(0), G::ramSize * sizeof(word_t))
+           <= ramBytes(used * frameBytes));
+    assert(stats.freeFrameAllocations < G::numFrames);
+}
+
+// bytes of the whole process the system has committed
+static uint64_t processBytes() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    assert(statm != nullptr);
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    int result = fscanf(statm, "%llu %llu", &size, &resident);
+    assert(result == 2);
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// the bookkeeping of the frames is committed as they are handed out, like
+// the RAM: for 2^18 frames it would take several MiB up front, with any
+// policy
+static void bookkeeping(int policy) {
+    const uint64_t before = processBytes();
+    PhysicalMemory<Wide> memory;
+    AddressSpace<Wide> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    result = memory.frameTable().setPolicy(policy);
+    assert(result == 1);
+    for (uint64_t i = 0; i < 200; ++i) {
+        result = space.write(addressOf<Wide>(i, 200), valueOf(7, i, 1));
+        assert(result == 1);
+    }
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t used = statsOf(memory).freeFrameAllocations + 2;
+    const uint64_t infoBytes = Wide::numFrames * sizeof(frame_info);
+    assert(residentBytes(memory.frameTable().frameInfo().data(), infoBytes)
+           <= (used * sizeof(frame_info) / page + 1) * page);
+    const uint64_t frameBytes = Wide::pageSize * sizeof(word_t);
+    assert(processBytes() - before <= ramBytes(used * frameBytes)
+                                      + (1 << 20));
+}
+
+int main(int argc, char **argv) {
+    spread<Wide>(200);
+    // many more tables than frames: tables are reclaimed and pages
+    // evicted at every layer
+    spread<Tall>(300);
+    for (int policy = 0; policy < POLICY_COUNT; ++policy) {
+        bookkeeping(policy);
+    }
+
+#ifdef VM_WORD64
+    // words wider than 32 bits, in RAM and through the compressed swap
+    PhysicalMemory<Tall> memory;
+    AddressSpace<Tall> space(memory);
+    int result = space.initialize(SWAP_COMPRESSED, nullptr);
+    assert(result == 1);
+    const word_t wide = (word_t) 0x123456789abcdef0LL;
+    for (uint64_t i = 0; i < 300; ++i) {
+        result = space.write(addressOf<Tall>(i, 300), wide + (word_t) i);
+        assert(result == 1);
+    }
+    for (uint64_t i = 0; i < 300; ++i) {
+        word_t value;
+        result = space.read(addressOf<Tall>(i, 300), &value);
+        assert(result == 1);
+        assert(value == wide + (word_t) i);
+    }
+#endif
+
+    printf("success\n");
+    return 0;
+}
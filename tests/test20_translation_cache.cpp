@@ -0,0 +1,120 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+
+// one table level: 15 frames for pages, 16 pages, all in distinct sets
+// of the translation cache
+typedef Geometry<4, 8, 8> Flat;
+
+// hits and misses of the translation cache of one address space, and the
+// words read to translate
+void counters() {
+    PhysicalMemory<Flat> memory;
+    AddressSpace<Flat> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    assert(space.tlbHitCount() == 0 && space.tlbMissCount() == 0);
+
+    // the first access of a page walks the tables and caches the frame
+    result = space.write(0, 7);
+    assert(result == 1);
+    assert(space.tlbHitCount() == 0 && space.tlbMissCount() == 1);
+
+    // later accesses of the page hit and read no table entry: a write
+    // reads nothing, a read only the word itself
+    vm_stats before = statsOf(memory);
+    result = space.write(1, 8);
+    assert(result == 1);
+    assert(space.tlbHitCount() == 1 && space.tlbMissCount() == 1);
+    vm_stats after = statsOf(memory);
+    assert(after.pmReads == before.pmReads);
+    word_t value = 0;
+    result = space.read(0, &value);
+    assert(result == 1 && value == 7);
+    assert(space.tlbHitCount() == 2 && space.tlbMissCount() == 1);
+    before = after;
+    after = statsOf(memory);
+#ifndef VM_THREADS
+    // the word counters are not kept with VM_THREADS
+    assert(after.pmReads == before.pmReads + 1);
+#endif
+    assert(after.faultingWalks == before.faultingWalks);
+
+    // initialize empties the cache and clears its counters
+    result = space.initialize();
+    assert(result == 1);
+    assert(space.tlbHitCount() == 0 && space.tlbMissCount() == 0);
+}
+
+// a page evicted while cached misses on its next access and reads back
+// from swap; the pages still resident keep hitting
+void eviction() {
+    PhysicalMemory<Flat> memory;
+    AddressSpace<Flat> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    for (uint64_t p = 0; p < Flat::numPages - 1; ++p) {
+        result = space.write(p * Flat::pageSize, (word_t) (p + 1));
+        assert(result == 1);
+    }
+    // every page is cached now: reading them all back only hits
+    const uint64_t misses = space.tlbMissCount();
+    for (uint64_t p = 0; p < Flat::numPages - 1; ++p) {
+        word_t value;
+        result = space.read(p * Flat::pageSize, &value);
+        assert(result == 1 && value == (word_t) (p + 1));
+    }
+    assert(space.tlbMissCount() == misses);
+
+    // the last page takes the frame of a cached one
+    const uint64_t last = Flat::numPages - 1;
+    result = space.write(last * Flat::pageSize, (word_t) (last + 1));
+    assert(result == 1);
+    vm_stats stats = statsOf(memory);
+    assert(stats.evictions == 1);
+
+    // exactly the pages that fault back miss, and the evicted one does
+    uint64_t restored = 0;
+    for (uint64_t p = 0; p < Flat::numPages; ++p) {
+        const uint64_t hits = space.tlbHitCount();
+        const uint64_t missed = space.tlbMissCount();
+        const vm_stats before = statsOf(memory);
+        word_t value;
+        result = space.read(p * Flat::pageSize, &value);
+        assert(result == 1 && value == (word_t) (p + 1));
+        const vm_stats after = statsOf(memory);
+        const bool faulted = after.swapFaults != before.swapFaults;
+        assert(space.tlbMissCount() == missed + (faulted ? 1 : 0));
+        assert(space.tlbHitCount() == hits + (faulted ? 0 : 1));
+        if (faulted) {
+            ++restored;
+        }
+    }
+    assert(restored > 0);
+}
+
+int main(int argc, char **argv) {
+    counters();
+    eviction();
+
+    // the counters of the VM* functions
+    VMinitialize();
+    assert(VMtlbHits() == 0 && VMtlbMisses() == 0);
+    int result = VMwrite(0, 3);
+    assert(result == 1);
+    assert(VMtlbHits() == 0 && VMtlbMisses() == 1);
+    word_t value = 0;
+    result = VMread(1, &value);
+    assert(result == 1 && value == 0);
+    result = VMread(0, &value);
+    assert(result == 1 && value == 3);
+    assert(VMtlbHits() == 2 && VMtlbMisses() == 1);
+    VMinitialize();
+    assert(VMtlbHits() == 0 && VMtlbMisses() == 0);
+
+    printf("success\n");
+    return 0;
+}
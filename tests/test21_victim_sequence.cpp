@@ -0,0 +1,140 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+#include "TestUtil.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+// 16 frames under four table levels, so that pages, tables and emptied
+// tables compete for the frames
+typedef Geometry<4, 8, 20> Narrow;
+
+#define STEPS 64
+
+// a page taken out of RAM while accessing the page of 'step'
+typedef struct eviction{
+    int step;
+    uint64_t page;
+    word_t frame;
+}eviction;
+
+// the frame each access leaves its page in; pinned with -DVM_CHECK_INDEX,
+// which checks every victim and reused frame against the full scans of
+// the tables
+static const word_t expectedFrames[STEPS] = {
+    4, 4, 8, 12, 12, 8, 8, 12, 12, 12, 8, 8, 4, 8, 8, 3,
+    13, 4, 3, 4, 4, 8, 3, 3, 12, 10, 12, 12, 8, 11, 4, 11,
+    5, 9, 12, 5, 5, 9, 12, 5, 12, 12, 12, 9, 9, 7, 15, 7,
+    15, 15, 7, 12, 12, 7, 12, 7, 7, 15, 7, 14, 15, 14, 7, 14,
+};
+
+// the evicted pages in order, the pages of one step by page number
+static const eviction expectedEvictions[] = {
+    {4, 16841, 12}, {5, 50523, 8}, {6, 16841, 8},
+    {7, 41337, 12}, {8, 16841, 12}, {9, 42868, 12},
+    {10, 39806, 8}, {11, 7655, 8}, {12, 58178, 4},
+    {13, 35213, 8}, {14, 6124, 8}, {16, 18372, 4},
+    {17, 50523, 13}, {18, 9186, 12}, {18, 10717, 3},
+    {19, 22965, 4}, {20, 45930, 4}, {21, 26027, 8},
+    {22, 38275, 3}, {25, 35213, 12}, {26, 9186, 10},
+    {27, 33682, 4}, {27, 35213, 12}, {28, 52054, 8},
+    {30, 1531, 12}, {31, 10717, 3}, {31, 12248, 11},
+    {33, 15310, 8}, {34, 18372, 4}, {35, 26027, 11},
+    {35, 27558, 5}, {36, 41337, 5}, {37, 45930, 9},
+    {38, 53585, 12}, {39, 3062, 5}, {40, 26027, 12},
+    {41, 55116, 12}, {42, 18372, 12}, {43, 7655, 9},
+    {46, 36744, 5}, {47, 45930, 7}, {47, 47461, 9},
+    {48, 7655, 15}, {49, 39806, 15}, {50, 16841, 7},
+    {51, 56647, 12}, {52, 24496, 12}, {53, 50523, 7},
+    {54, 55116, 12}, {55, 4593, 7}, {56, 45930, 7},
+    {57, 3062, 15}, {58, 9186, 7}, {61, 26027, 14},
+    {61, 27558, 12}, {62, 38275, 7}, {63, 59709, 14},
+};
+
+// the frame 'page' is in, read off the tables; 0 if it is not in RAM
+template <class G>
+static word_t frameOf(PhysicalMemory<G>& memory, uint64_t page) {
+    word_t frame = 0;
+    for (int layer = 0; layer < G::tablesDepth; ++layer) {
+        word_t entry;
+        memory.read(frame * G::pageSize + G::tableIndex(layer, page),
+                    &entry);
+        if (entry == 0) {
+            return 0;
+        }
+        frame = entry;
+    }
+    return frame;
+}
+
+// a fixed mix of writes and reads over 40 pages spread across the
+// tables evicts the same pages and reuses the same frames, tables
+// emptied by the evictions included
+void sequence() {
+    PhysicalMemory<Narrow> memory;
+    AddressSpace<Narrow> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+
+    std::vector<bool> written(Narrow::numPages);
+    // the pages in RAM by page number, and their frames
+    std::vector<uint64_t> pages;
+    std::vector<word_t> frames;
+    const uint64_t expectedCount =
+        sizeof(expectedEvictions) / sizeof(expectedEvictions[0]);
+    uint64_t evicted = 0;
+    uint64_t x = 1;
+    for (int step = 0; step < STEPS; ++step) {
+        x = x * 1103515245 + 12345;
+        const uint64_t page = ((x >> 16) % 40) * 1531 % Narrow::numPages;
+        if (written[page] && step % 3 == 0) {
+            word_t value;
+            result = space.read(page * Narrow::pageSize, &value);
+            assert(result == 1 && value == (word_t) (page + 1));
+        } else {
+            result = space.write(page * Narrow::pageSize,
+                                 (word_t) (page + 1));
+            assert(result == 1);
+            written[page] = true;
+        }
+
+        const word_t frame = frameOf(memory, page);
+        assert(frame == expectedFrames[step]);
+        std::vector<uint64_t> keptPages;
+        std::vector<word_t> keptFrames;
+        for (uint64_t i = 0; i < pages.size(); ++i) {
+            if (pages[i] == page) {
+                continue;
+            }
+            if (frameOf(memory, pages[i]) != 0) {
+                keptPages.push_back(pages[i]);
+                keptFrames.push_back(frames[i]);
+                continue;
+            }
+            assert(evicted < expectedCount);
+            const eviction& expected = expectedEvictions[evicted++];
+            assert(expected.step == step && expected.page == pages[i]);
+            assert(expected.frame == frames[i]);
+        }
+        // the page accessed joins the others in page order
+        std::vector<uint64_t>::iterator at =
+            std::lower_bound(keptPages.begin(), keptPages.end(), page);
+        keptFrames.insert(keptFrames.begin() + (at - keptPages.begin()),
+                          frame);
+        keptPages.insert(at, page);
+        pages.swap(keptPages);
+        frames.swap(keptFrames);
+    }
+    assert(evicted == expectedCount);
+    const vm_stats stats = statsOf(memory);
+    assert(stats.evictions == expectedCount);
+}
+
+int main(int argc, char **argv) {
+    sequence();
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SWAP_PATH "vm_test3.swap"
+
+// 16 frames of 16 words, 256 pages over 2 tables
+typedef Geometry<4, 8, 12> Small;
+
+// writes every word of the virtual memory and reads it back through
+// the given swap backend
+void writeReadAll(int backend) {
+    int result = VMinitialize(backend, SWAP_PATH);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; ++i) {
+        VMwrite(i, i);
+    }
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; ++i) {
+        word_t value;
+        VMread(i, &value);
+        assert(uint64_t(value) == i);
+    }
+    assert(physicalMemory.swapDevice().bytesWritten() > 0);
+    assert(physicalMemory.swapDevice().bytesRead() > 0);
+}
+
+// reopens the swap file under the descriptor the swap device holds, with
+// 'flags': its stores fail with O_RDONLY and its loads with O_WRONLY
+static void reopenSwap(int flags) {
+    char path[PATH_MAX];
+    const char* resolved = realpath(SWAP_PATH, path);
+    assert(resolved != nullptr);
+    for (int fd = 0; fd < 1024; ++fd) {
+        char link[64];
+        char target[PATH_MAX];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        const ssize_t length = readlink(link, target, sizeof(target) - 1);
+        if (length < 0) {
+            continue;
+        }
+        target[length] = 0;
+        if (strcmp(target, path) == 0) {
+            const int reopened = open(SWAP_PATH, flags);
+            assert(reopened >= 0);
+            const int replaced = dup2(reopened, fd);
+            assert(replaced == fd);
+            close(reopened);
+            return;
+        }
+    }
+    assert(false);
+}
+
+// accesses that need the swap file while it fails return 0 and lose
+// nothing: once it works again every page reads back
+static void swapErrors() {
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> space(memory);
+    int result = space.initialize(SWAP_PREAD, SWAP_PATH);
+    assert(result == 1);
+    const uint64_t half = Small::numPages / 2;
+    for (uint64_t p = 0; p < half; ++p) {
+        result = space.write(p * Small::pageSize, (word_t) (p + 1));
+        assert(result == 1);
+    }
+
+    // the pages in RAM are dirty, so no frame can be had for new ones
+    reopenSwap(O_RDONLY);
+    for (uint64_t p = half; p < Small::numPages; ++p) {
+        result = space.write(p * Small::pageSize, (word_t) (p + 1));
+        assert(result == 0);
+    }
+    std::vector<word_t> buffer(2 * Small::pageSize);
+    const int readRange = space.readRange(0, buffer.data(), buffer.size());
+    const int filled = space.fill(half * Small::pageSize, 1,
+                                  Small::pageSize);
+    assert(readRange == 0 || filled == 0);
+    reopenSwap(O_RDWR);
+    for (uint64_t p = 0; p < half; ++p) {
+        word_t value;
+        result = space.read(p * Small::pageSize, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p + 1));
+    }
+
+    // swapped pages cannot be read back, the others still can
+    reopenSwap(O_WRONLY);
+    uint64_t failed = 0;
+    for (uint64_t p = 0; p < half; ++p) {
+        word_t value;
+        if (space.read(p * Small::pageSize, &value) == 0) {
+            ++failed;
+        } else {
+            assert(value == (word_t) (p + 1));
+        }
+    }
+    assert(failed > 0);
+    result = space.copy(half * Small::pageSize, 0, half * Small::pageSize);
+    assert(result == 0);
+    reopenSwap(O_RDWR);
+    for (uint64_t p = 0; p < Small::numPages; ++p) {
+        result = space.write(p * Small::pageSize + 1, (word_t) p);
+        assert(result == 1);
+    }
+    for (uint64_t p = 0; p < Small::numPages; ++p) {
+        word_t value;
+        result = space.read(p * Small::pageSize, &value);
+        assert(result == 1);
+        assert(value == (p < half ? (word_t) (p + 1) : 0));
+        result = space.read(p * Small::pageSize + 1, &value);
+        assert(result == 1);
+        assert(value == (word_t) p);
+    }
+}
+
+int main(int argc, char **argv) {
+    writeReadAll(SWAP_PREAD);
+    writeReadAll(SWAP_MMAP);
+    writeReadAll(SWAP_URING);
+    writeReadAll(SWAP_MEMORY);
+    swapErrors();
+    unlink(SWAP_PATH);
+
+    // a swap file that cannot be created leaves the memory usable
+    int result = VMinitialize(SWAP_PREAD, "/nonexistent/vm_test3.swap");
+    assert(result == 0);
+    // and so does a file backend without a path
+    result = VMinitialize(SWAP_MMAP, nullptr);
+    assert(result == 0);
+    VMinitialize();
+    VMwrite(0, 5);
+    word_t value;
+    VMread(0, &value);
+    assert(value == 5);
+
+    printf("success\n");
+    return 0;
+}
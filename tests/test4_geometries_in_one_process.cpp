@@ -0,0 +1,80 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <sys/resource.h>
+
+// writes every word of a virtual memory of geometry G and reads it back,
+// then checks that the memory of the VM* functions was left alone
+template <class G>
+void writeReadAll() {
+    PhysicalMemory<G> memory;
+    AddressSpace<G> vm(memory);
+    vm.initialize();
+    for (uint64_t i = 0; i < G::virtualMemorySize; ++i) {
+        vm.write(i, i);
+    }
+    for (uint64_t i = 0; i < G::virtualMemorySize; ++i) {
+        word_t value = 0;
+        vm.read(i, &value);
+        assert(uint64_t(value) == i);
+    }
+    int result = vm.write(G::virtualMemorySize, 0);
+    assert(result == 0);
+    assert(memory.evictionCount() > 0);
+
+    word_t value;
+    VMread(0, &value);
+    assert(value == 42);
+}
+
+// a memory whose RAM cannot be mapped, under an address space limit too
+// small for it, fails to initialize instead of aborting
+void ramTooLarge() {
+    // 256 frames of 16 Mi words, 16 GiB at the least
+    typedef Geometry<24, 32, 40> Large;
+    struct rlimit saved;
+    int result = getrlimit(RLIMIT_AS, &saved);
+    assert(result == 0);
+    struct rlimit lowered = saved;
+    lowered.rlim_cur = 1ULL << 30;
+    result = setrlimit(RLIMIT_AS, &lowered);
+    assert(result == 0);
+    {
+        PhysicalMemory<Large> memory;
+        AddressSpace<Large> vm(memory);
+        assert(memory.allocated() == 0);
+        result = vm.initialize();
+        assert(result == 0);
+        result = vm.initialize(SWAP_MEMORY, nullptr);
+        assert(result == 0);
+        word_t value;
+        result = vm.write(0, 1);
+        assert(result == 0);
+        result = vm.read(0, &value);
+        assert(result == 0);
+    }
+    result = setrlimit(RLIMIT_AS, &saved);
+    assert(result == 0);
+}
+
+int main(int argc, char **argv) {
+    VMinitialize();
+    VMwrite(0, 42);
+
+    writeReadAll<Geometry<1, 4, 5> >();     // tests/MemoryConstants_test1.h
+    writeReadAll<Geometry<2, 5, 12> >();    // tests/MemoryConstants_test2.h
+    writeReadAll<Geometry<3, 7, 15> >();
+    writeReadAll<Geometry<4, 8, 19> >();    // 15 page bits over 4 tables
+    writeReadAll<Geometry<5, 9, 13> >();    // 8 page bits over 2 tables
+    ramTooLarge();
+
+    static_assert(Geometry<4, 8, 19>::tablesDepth == 4, "depth");
+    static_assert(Geometry<4, 8, 19>::layerWidth(0) == 4, "first layer");
+    static_assert(Geometry<4, 8, 19>::layerWidth(3) == 3, "last layer");
+    static_assert(Geometry<4, 8, 19>::layerShift(0) == 11, "first shift");
+
+    printf("success\n");
+    return 0;
+}
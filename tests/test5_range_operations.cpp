@@ -0,0 +1,75 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// runs the range operations against a shadow copy of the virtual memory
+template <class G>
+void checkRanges(AddressSpace<G>& vm) {
+    const uint64_t size = G::virtualMemorySize;
+    const uint64_t page = G::pageSize;
+    std::vector<word_t> shadow(size, 0);
+    vm.initialize();
+
+    // fill everything, then write a range that starts and ends mid-page
+    int result = vm.fill(0, 7, size);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; ++i) shadow[i] = 7;
+    std::vector<word_t> buffer(3 * page + 3);
+    for (uint64_t i = 0; i < buffer.size(); ++i) buffer[i] = 1000 + i;
+    const uint64_t start = size / 2 - page - 1;
+    result = vm.writeRange(start, buffer.data(), buffer.size());
+    assert(result == 1);
+    for (uint64_t i = 0; i < buffer.size(); ++i) shadow[start + i] = buffer[i];
+
+    // copies between distant pages, then overlapping in both directions
+    result = vm.copy(1, start, 2 * page + 1);
+    assert(result == 1);
+    for (uint64_t i = 0; i < 2 * page + 1; ++i) shadow[1 + i] = shadow[start + i];
+    result = vm.copy(start + 2, start, page + 3);
+    assert(result == 1);
+    for (uint64_t i = page + 3; i-- > 0; ) shadow[start + 2 + i] = shadow[start + i];
+    result = vm.copy(start, start + 3, 2 * page);
+    assert(result == 1);
+    for (uint64_t i = 0; i < 2 * page; ++i) shadow[start + i] = shadow[start + 3 + i];
+
+    std::vector<word_t> all(size);
+    result = vm.readRange(0, all.data(), size);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; ++i) {
+        assert(all[i] == shadow[i]);
+        word_t value;
+        vm.read(i, &value);
+        assert(value == shadow[i]);
+    }
+
+    // ranges that leave the virtual memory are rejected
+    result = vm.readRange(size - 1, all.data(), 2);
+    assert(result == 0);
+    result = vm.writeRange(0, nullptr, 1);
+    assert(result == 0);
+    result = vm.copy(size - 1, 0, 2);
+    assert(result == 0);
+    result = vm.fill(size, 0, 0);
+    assert(result == 0);
+    result = vm.readRange(size - 1, all.data(), 0);
+    assert(result == 1);
+}
+
+int main(int argc, char **argv) {
+    checkRanges(virtualMemory);
+
+    // RAM too small to keep the pages of both sides of a copy resident
+    PhysicalMemory<Geometry<1, 4, 5> > tinyMemory;
+    AddressSpace<Geometry<1, 4, 5> > tiny(tinyMemory);
+    checkRanges(tiny);
+
+    PhysicalMemory<Geometry<2, 5, 12> > smallMemory;
+    AddressSpace<Geometry<2, 5, 12> > small(smallMemory);
+    checkRanges(small);
+
+    printf("success\n");
+    return 0;
+}
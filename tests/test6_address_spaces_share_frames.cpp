@@ -0,0 +1,116 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// several address spaces of geometry G on one physical memory, each
+// checked against its own shadow copy while the others fault its pages out
+template <class G>
+void shareFrames(int count) {
+    const uint64_t size = G::virtualMemorySize;
+    PhysicalMemory<G> memory;
+    std::vector<AddressSpace<G>*> spaces;
+    std::vector<std::vector<word_t> > shadows;
+    for (int s = 0; s < count; ++s) {
+        spaces.push_back(new AddressSpace<G>(memory));
+        int result = spaces[s]->initialize();
+        assert(result == 1);
+        shadows.push_back(std::vector<word_t>(size, 0));
+    }
+
+    // the same addresses in every space, interleaved, with different values
+    for (uint64_t i = 0; i < size; ++i) {
+        for (int s = 0; s < count; ++s) {
+            shadows[s][i] = (word_t) (i * (s + 3) + s);
+            int result = spaces[s]->write(i, shadows[s][i]);
+            assert(result == 1);
+        }
+    }
+    uint64_t seed = 1;
+    for (int n = 0; n < 20000; ++n) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const int s = (seed >> 60) % count;
+        const uint64_t address = (seed >> 20) % size;
+        if (seed & 1) {
+            shadows[s][address] = (word_t) n;
+            int result = spaces[s]->write(address, n);
+            assert(result == 1);
+        } else {
+            word_t value = 0;
+            int result = spaces[s]->read(address, &value);
+            assert(result == 1);
+            assert(value == shadows[s][address]);
+        }
+    }
+    assert(memory.evictionCount() > 0);
+
+    // reinitializing one space leaves the others alone
+    spaces[0]->initialize();
+    int result = spaces[0]->fill(0, 5, size);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; ++i) shadows[0][i] = 5;
+
+    // a destroyed space hands its id, frames and swap to a new one
+    delete spaces[count - 1];
+    spaces[count - 1] = new AddressSpace<G>(memory);
+    result = spaces[count - 1]->initialize();
+    assert(result == 1);
+    result = spaces[count - 1]->fill(0, 9, size);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size; ++i) shadows[count - 1][i] = 9;
+
+    for (int s = 0; s < count; ++s) {
+        std::vector<word_t> all(size);
+        result = spaces[s]->readRange(0, all.data(), size);
+        assert(result == 1);
+        for (uint64_t i = 0; i < size; ++i) {
+            assert(all[i] == shadows[s][i]);
+        }
+    }
+
+    // every space keeps a root table, so only so many fit
+    std::vector<AddressSpace<G>*> extra;
+    for (;;) {
+        AddressSpace<G>* space = new AddressSpace<G>(memory);
+        if (space->initialize() == 0) {
+            result = space->write(0, 1);
+            assert(result == 0);
+            delete space;
+            break;
+        }
+        extra.push_back(space);
+    }
+    assert(count + extra.size() == G::numFrames - G::tablesDepth);
+    for (size_t i = 0; i < extra.size(); ++i) {
+        result = extra[i]->write(size - 1, 3);
+        assert(result == 1);
+    }
+    for (size_t i = 0; i < extra.size(); ++i) delete extra[i];
+
+    for (int s = 0; s < count; ++s) {
+        word_t value = 0;
+        result = spaces[s]->read(size / 2, &value);
+        assert(result == 1);
+        assert(value == shadows[s][size / 2]);
+        delete spaces[s];
+    }
+}
+
+int main(int argc, char **argv) {
+    VMinitialize();
+    VMwrite(0, 42);
+
+    shareFrames<Geometry<1, 4, 5> >(2);
+    shareFrames<Geometry<2, 5, 12> >(3);
+    shareFrames<Geometry<2, 7, 12> >(4);
+    shareFrames<Geometry<4, 10, 16> >(8);
+
+    word_t value = 0;
+    VMread(0, &value);
+    assert(value == 42);
+
+    printf("success\n");
+    return 0;
+}
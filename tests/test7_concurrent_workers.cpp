@@ -0,0 +1,81 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <thread>
+
+// 16 frames for the roots of five spaces and four workers faulting at once
+typedef Geometry<2, 6, 12> Small;
+
+#define WORKERS 4
+#define ROUNDS 30
+
+// each worker owns every WORKERS-th page of the shared space, so the
+// workers share its tables but not its pages, and has a space of its own
+void work(AddressSpace<Small>* shared, AddressSpace<Small>* own, int id) {
+    const uint64_t page = Small::pageSize;
+    const uint64_t pages = Small::numPages;
+    std::vector<word_t> buffer(page);
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (uint64_t p = id; p < pages; p += WORKERS) {
+            for (uint64_t i = 0; i < page; ++i) buffer[i] = p * 100 + round;
+            int result = shared->writeRange(p * page, buffer.data(), page);
+            assert(result == 1);
+        }
+        int result = own->fill(0, round, Small::virtualMemorySize);
+        assert(result == 1);
+        for (uint64_t p = id; p < pages; p += WORKERS) {
+            word_t value = 0;
+            result = shared->read(p * page + round % page, &value);
+            assert(result == 1);
+            assert(value == (word_t) (p * 100 + round));
+            result = own->read(p * page, &value);
+            assert(result == 1);
+            assert(value == round);
+        }
+        result = own->copy(page, 0, Small::virtualMemorySize - page);
+        assert(result == 1);
+        result = own->write(0, id);
+        assert(result == 1);
+        word_t value = 0;
+        result = own->read(0, &value);
+        assert(result == 1 && value == id);
+    }
+}
+
+int main(int argc, char **argv) {
+    PhysicalMemory<Small> memory;
+    AddressSpace<Small> shared(memory);
+    int result = shared.initialize();
+    assert(result == 1);
+    std::vector<AddressSpace<Small>*> own;
+    for (int w = 0; w < WORKERS; ++w) {
+        own.push_back(new AddressSpace<Small>(memory));
+        result = own[w]->initialize();
+        assert(result == 1);
+    }
+
+#ifdef VM_THREADS
+    std::vector<std::thread> workers;
+    for (int w = 0; w < WORKERS; ++w) {
+        workers.push_back(std::thread(work, &shared, own[w], w));
+    }
+    for (int w = 0; w < WORKERS; ++w) workers[w].join();
+#else
+    for (int w = 0; w < WORKERS; ++w) work(&shared, own[w], w);
+#endif
+
+    for (uint64_t p = 0; p < Small::numPages; ++p) {
+        word_t value = 0;
+        result = shared.read(p * Small::pageSize, &value);
+        assert(result == 1);
+        assert(value == (word_t) (p * 100 + ROUNDS - 1));
+    }
+    assert(memory.evictionCount() > 0);
+    for (int w = 0; w < WORKERS; ++w) delete own[w];
+
+    printf("success\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+
+// one table level: 15 frames for pages, 16 pages
+typedef Geometry<4, 8, 8> Flat;
+
+// fills pages 0..14, uses page 0 once more and faults page 15 in;
+// returns the page that was evicted for it
+int victimOf(int policy) {
+    PhysicalMemory<Flat> memory;
+    int result = memory.frameTable().setPolicy(policy);
+    assert(result == 1);
+    AddressSpace<Flat> space(memory);
+    result = space.initialize();
+    assert(result == 1);
+    for (uint64_t p = 0; p < 15; ++p) {
+        result = space.write(p * Flat::pageSize, (word_t) p);
+        assert(result == 1);
+    }
+    assert(memory.evictionCount() == 0);
+    word_t value = 0;
+    result = space.read(0, &value);
+    assert(result == 1 && value == 0);
+    result = space.write(15 * Flat::pageSize, 15);
+    assert(result == 1);
+    assert(memory.evictionCount() == 1);
+    int evicted = -1;
+    for (uint64_t p = 0; p < 15; ++p) {
+        if (memory.swapDevice().contains(p)) {
+            assert(evicted == -1);
+            evicted = (int) p;
+        }
+    }
+    return evicted;
+}
+
+// with ARC: fills pages 0..14 and uses pages 0..13 once more, so T1
+// holds page 14 alone, then faults page 15 in, which evicts page 14 to
+// B1, and page 14 back in; returns the page evicted for page 14
+int arcGhostVictim() {
+    PhysicalMemory<Flat> memory;
+    int result = memory.frameTable().setPolicy(POLICY_ARC);
+    assert(result == 1);
+    AddressSpace<Flat> space(memory);
+    result = space.initialize();
+    assert(result == 1);
+    for (uint64_t p = 0; p < 15; ++p) {
+        result = space.write(p * Flat::pageSize, (word_t) p);
+        assert(result == 1);
+    }
+    word_t value = 0;
+    for (uint64_t p = 0; p < 14; ++p) {
+        result = space.read(p * Flat::pageSize, &value);
+        assert(result == 1 && value == (word_t) p);
+    }
+    result = space.write(15 * Flat::pageSize, 15);
+    assert(result == 1);
+    result = memory.swapDevice().contains(14);
+    assert(result == 1);
+    result = space.read(14 * Flat::pageSize, &value);
+    assert(result == 1 && value == 14);
+    assert(memory.evictionCount() == 2);
+    // page 14 keeps its copy in swap
+    int evicted = -1;
+    for (uint64_t p = 0; p < 16; ++p) {
+        if (p != 14 && memory.swapDevice().contains(p)) {
+            assert(evicted == -1);
+            evicted = (int) p;
+        }
+    }
+    return evicted;
+}
+
+// two spaces under one policy, checked against shadow copies; the
+// policy is switched halfway with pages resident
+template <class G>
+uint64_t shadowed(int policy, int next) {
+    const uint64_t size = G::virtualMemorySize;
+    PhysicalMemory<G> memory;
+    int result = memory.frameTable().setPolicy(policy);
+    assert(result == 1);
+    AddressSpace<G> a(memory), b(memory);
+    result = a.initialize();
+    assert(result == 1);
+    result = b.initialize();
+    assert(result == 1);
+    AddressSpace<G>* spaces[2] = {&a, &b};
+    std::vector<word_t> shadows[2] = {std::vector<word_t>(size, 1),
+                                      std::vector<word_t>(size, 2)};
+    // pages that were never written hold garbage
+    result = a.fill(0, 1, size);
+    assert(result == 1);
+    result = b.fill(0, 2, size);
+    assert(result == 1);
+    uint64_t seed = 7;
+    for (int n = 0; n < 40000; ++n) {
+        if (n == 20000) {
+            result = memory.frameTable().setPolicy(next);
+            assert(result == 1);
+        }
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const int s = (seed >> 62) & 1;
+        // a hot quarter of the memory and a cold rest
+        uint64_t address = (seed >> 20) % size;
+        if ((seed >> 10) % 4 != 0) address %= size / 4;
+        if (seed & 1) {
+            shadows[s][address] = (word_t) n;
+            result = spaces[s]->write(address, n);
+            assert(result == 1);
+        } else {
+            word_t value = 0;
+            result = spaces[s]->read(address, &value);
+            assert(result == 1);
+            assert(value == shadows[s][address]);
+        }
+    }
+    // copies pin their source whatever the policy
+    result = a.copy(size / 2, 0, size / 2);
+    assert(result == 1);
+    for (uint64_t i = 0; i < size / 2; ++i) {
+        word_t value = 0;
+        result = a.read(size / 2 + i, &value);
+        assert(result == 1);
+        assert(value == shadows[0][i]);
+    }
+    assert(memory.evictionCount() > 0);
+    return memory.evictionCount();
+}
+
+int main(int argc, char **argv) {
+    int result = victimOf(POLICY_CYCLIC);
+    assert(result == 7);
+    // every path weighs the same, the lowest page goes
+    result = victimOf(POLICY_WEIGHTED);
+    assert(result == 0);
+    result = victimOf(POLICY_LRU);
+    assert(result == 1);
+    // every page was referenced, so the hand comes round to the first
+    result = victimOf(POLICY_CLOCK);
+    assert(result == 0);
+    result = victimOf(POLICY_LFU);
+    assert(result == 1);
+    // page 0 was seen twice and moved to T2
+    result = victimOf(POLICY_ARC);
+    assert(result == 1);
+    // the B1 hit grows the target of T1 to 1 before the victim is chosen,
+    // so it comes from T2 and page 15 stays
+    result = arcGhostVictim();
+    assert(result == 0);
+
+    for (int policy = 0; policy < POLICY_COUNT; ++policy) {
+        const int next = (policy + 1) % POLICY_COUNT;
+        shadowed<Geometry<2, 7, 12> >(policy, next);
+        shadowed<Geometry<3, 8, 11> >(policy, next);
+    }
+
+    // the VM* functions keep their memory through a change of policy
+    VMinitialize();
+    result = VMsetReplacementPolicy(POLICY_COUNT);
+    assert(result == 0);
+    result = VMsetReplacementPolicy(POLICY_LRU);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE / 2) {
+        result = VMwrite(i, (word_t) (i / 3));
+        assert(result == 1);
+    }
+    result = VMsetReplacementPolicy(POLICY_ARC);
+    assert(result == 1);
+    for (uint64_t i = 0; i < VIRTUAL_MEMORY_SIZE; i += PAGE_SIZE / 2) {
+        word_t value = 0;
+        result = VMread(i, &value);
+        assert(result == 1 && value == (word_t) (i / 3));
+    }
+    result = VMsetReplacementPolicy(POLICY_CYCLIC);
+    assert(result == 1);
+
+    printf("success\n");
+    return 0;
+}
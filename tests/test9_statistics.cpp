@@ -0,0 +1,126 @@
+#include "VirtualMemory.h"
+#include "PhysicalMemory.h"
+
+#include <cstdio>
+#include <cassert>
+
+// one table level: 15 frames for pages, 16 pages
+typedef Geometry<4, 8, 8> Flat;
+// three table levels, 7 frames besides the root
+typedef Geometry<2, 5, 8> Deep;
+
+static uint64_t latencyTotal(const vm_stats& stats) {
+    uint64_t total = 0;
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i) {
+        total += stats.faultLatency[i];
+    }
+    return total;
+}
+
+// faults of a single table level, by cause
+void flat() {
+    PhysicalMemory<Flat> memory;
+    AddressSpace<Flat> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    memory.stats().reset();
+
+    for (uint64_t p = 0; p < 15; ++p) {
+        result = space.write(p * Flat::pageSize, (word_t) p);
+        assert(result == 1);
+    }
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.faults == 15 && stats.firstTouchFaults == 15);
+    assert(stats.swapFaults == 0 && stats.tableFaults == 0);
+    assert(stats.freeFrameAllocations == 15 && stats.evictions == 0);
+    assert(stats.faultingWalks == 15 && stats.faultTablesVisited == 15);
+#ifdef VM_THREADS
+    // each entry is read again once its table is locked for the fault
+    assert(stats.faultReads == 30 && latencyTotal(stats) == 15);
+#else
+    assert(stats.faultReads == 15 && latencyTotal(stats) == 15);
+#endif
+
+    // translations that hit add nothing but the words they access
+    word_t value = 0;
+    result = space.read(0, &value);
+    assert(result == 1 && value == 0);
+    memory.stats().snapshot(&stats);
+    assert(stats.faultingWalks == 15);
+#ifndef VM_THREADS
+    const uint64_t reads = stats.pmReads;
+#endif
+
+    // a 16th page evicts one, which comes back from swap
+    result = space.write(15 * Flat::pageSize, 15);
+    assert(result == 1);
+    for (uint64_t p = 0; p < 16; ++p) {
+        result = space.read(p * Flat::pageSize, &value);
+        assert(result == 1);
+        assert(value == (word_t) p);
+    }
+    memory.stats().snapshot(&stats);
+    assert(stats.evictions >= 2 && stats.evictions == memory.evictionCount());
+    assert(stats.swapFaults == stats.evictions - 1);
+    assert(stats.faults == stats.firstTouchFaults + stats.swapFaults);
+#ifndef VM_THREADS
+    // the word counters are not kept with VM_THREADS
+    assert(stats.pmReads > reads && stats.pmWrites > 0);
+#endif
+
+    memory.stats().reset();
+    memory.stats().snapshot(&stats);
+    assert(stats.faults == 0 && stats.evictions == 0 && stats.pmReads == 0);
+    assert(latencyTotal(stats) == 0);
+}
+
+// table faults, and empty tables reused for the frames of new faults
+void deep() {
+    PhysicalMemory<Deep> memory;
+    AddressSpace<Deep> space(memory);
+    int result = space.initialize();
+    assert(result == 1);
+    memory.stats().reset();
+
+    for (uint64_t p = 0; p < Deep::numPages; ++p) {
+        result = space.write(p * Deep::pageSize, (word_t) p);
+        assert(result == 1);
+    }
+    vm_stats stats;
+    memory.stats().snapshot(&stats);
+    assert(stats.faults == Deep::numPages);
+    assert(stats.tableFaults > 0 && stats.emptyTableReuses > 0);
+    assert(stats.freeFrameAllocations == Deep::numFrames - 1);
+    // every fault takes a frame: off the free list, an empty table or a
+    // victim page
+    assert(stats.faults + stats.tableFaults
+           == stats.freeFrameAllocations + stats.emptyTableReuses
+              + stats.evictions);
+    assert(stats.faultingWalks == Deep::numPages);
+    assert(stats.faultTablesVisited == Deep::numPages * Deep::tablesDepth);
+    assert(latencyTotal(stats) == stats.faultingWalks);
+}
+
+int main(int argc, char **argv) {
+    flat();
+    deep();
+
+    // the statistics of the VM* functions
+    VMinitialize();
+    VMresetStats();
+    for (uint64_t i = 0; i < NUM_PAGES; ++i) {
+        int result = VMwrite(i * PAGE_SIZE, (word_t) i);
+        assert(result == 1);
+    }
+    vm_stats stats;
+    VMgetStats(&stats);
+    assert(stats.faults == NUM_PAGES);
+    assert(stats.firstTouchFaults == NUM_PAGES && stats.evictions > 0);
+    VMresetStats();
+    VMgetStats(&stats);
+    assert(stats.faults == 0 && stats.faultingWalks == 0);
+
+    printf("success\n");
+    return 0;
+}